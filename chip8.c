@@ -25,37 +25,283 @@
 #include <string.h>
 #include <time.h>
 
+#ifdef _WIN32
+// One-time initialisation needs Vista or later.
+#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0600
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
 #include "chip8.h"
+#include "chip8jit.h"
+#include "chip8aot.h"
+#include "chip8filter.h"
 #include "console.h"
-#include "filedialogs.h"
 
-const int CLIENTWIDTH = 640;
-const int CLIENTHEIGHT = 320;
+// The window's bitmap is the largest Chip8 display, low res is drawn at 2x2.
+const int CLIENTWIDTH = 128;
+const int CLIENTHEIGHT = 64;
+
+// Chip 8 Default Fonts.
+static const unsigned char Chip8_FontSet[80] =  {
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+};
+
+
+// high-res mode font sprites ('0'-'F')
+static const unsigned char Chip8_SuperFontSet[160] =  {
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+// Our Default Chip8 ROM.
+static const unsigned char Chip8_LogoRom[] = {
+    0x00,0xFF,0xA2,0xE4,0x60,0x00,0x61,0x00,0xD0,0x10,0xA3,0x04,0x60,0x10,0x61,0x00,0xD0,0x10,0xA3,0x24,0x60,0x20,0x61,0x00,0xD0,0x10,0xA3,0x44,0x60,0x30,
+    0x61,0x00,0xD0,0x10,0xA3,0x64,0x60,0x40,0x61,0x00,0xD0,0x10,0xA3,0x84,0x60,0x50,0x61,0x00,0xD0,0x10,0xA3,0xA4,0x60,0x60,0x61,0x00,0xD0,0x10,0xA3,0xC4,
+    0x60,0x70,0x61,0x00,0xD0,0x10,0xA3,0xE4,0x60,0x10,0x61,0x10,0xD0,0x10,0xA4,0x04,0x60,0x20,0x61,0x10,0xD0,0x10,0xA4,0x24,0x60,0x30,0x61,0x10,0xD0,0x10,
+    0xA4,0x44,0x60,0x40,0x61,0x10,0xD0,0x10,0xA4,0x64,0x60,0x50,0x61,0x10,0xD0,0x10,0xA4,0x84,0x60,0x60,0x61,0x10,0xD0,0x10,0xA4,0xA4,0x60,0x10,0x61,0x20,
+    0xD0,0x10,0xA4,0xC4,0x60,0x20,0x61,0x20,0xD0,0x10,0xA4,0xE4,0x60,0x30,0x61,0x20,0xD0,0x10,0xA5,0x04,0x60,0x40,0x61,0x20,0xD0,0x10,0xA5,0x24,0x60,0x50,
+    0x61,0x20,0xD0,0x10,0xA5,0x44,0x60,0x60,0x61,0x20,0xD0,0x10,0xA5,0x64,0x60,0x00,0x61,0x30,0xD0,0x10,0xA5,0x84,0x60,0x10,0x61,0x30,0xD0,0x10,0xA5,0xA4,
+    0x60,0x20,0x61,0x30,0xD0,0x10,0xA5,0xC4,0x60,0x30,0x61,0x30,0xD0,0x10,0xA5,0xE4,0x60,0x40,0x61,0x30,0xD0,0x10,0xA6,0x04,0x60,0x50,0x61,0x30,0xD0,0x10,
+    0xA6,0x24,0x60,0x60,0x61,0x30,0xD0,0x10,0xA6,0x44,0x60,0x70,0x61,0x30,0xD0,0x10,0x12,0xE2,0x00,0x00,0x00,0x00,0x0F,0xF8,0x0F,0xFD,0x2F,0xFD,0x3F,0xF9,
+    0x3F,0x01,0x3F,0xF9,0x1F,0xFD,0x00,0x7D,0x1F,0xFD,0x3F,0xFD,0x3F,0xF8,0x1F,0xF0,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xE1,0xC7,0x33,0xE9,0x73,0xEB,
+    0xF3,0xEF,0xF3,0xEF,0xF3,0xEF,0xF3,0xEF,0xF3,0xEF,0xF3,0xEF,0xFF,0xEF,0xFF,0xCF,0x7F,0x87,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0x3F,0xFE,0x4F,
+    0xFF,0x5F,0x9F,0x7E,0x9F,0x7E,0x9F,0x7F,0xFF,0x7F,0xFE,0x7E,0xFC,0x7E,0x80,0x7F,0x80,0x7F,0x80,0x3F,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xF1,0xFF,
+    0xFA,0x7F,0xF2,0xFF,0x03,0xF3,0x03,0xF3,0xFB,0xFF,0xFB,0xFF,0x03,0xFF,0x03,0xFF,0xF3,0xF7,0xFB,0xF3,0xF1,0xE1,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+    0x00,0x00,0x80,0x00,0xC0,0x01,0xC0,0x01,0xC0,0x01,0x80,0x01,0x00,0x01,0x80,0x01,0xC0,0x01,0xC0,0x01,0xC0,0x00,0x80,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+    0x00,0x00,0x7F,0xC7,0x7F,0xE9,0x7F,0xCB,0xF8,0x0F,0xF8,0x0F,0xF8,0x0F,0xF8,0x0F,0xF8,0x0F,0xF8,0x0F,0xFF,0xCF,0xFF,0xEF,0x7F,0xC7,0x00,0x00,0x00,0x00,
+    0x00,0x00,0x00,0x00,0x0E,0x3C,0x9F,0x4E,0x9F,0x5E,0x9F,0x7E,0x9F,0x7E,0xFF,0x7E,0xFF,0x7E,0x9F,0x7E,0x9F,0x7E,0x9F,0x7E,0x9F,0x7E,0x0E,0x3C,0x00,0x00,
+    0x00,0x00,0x00,0x00,0x00,0x00,0x3F,0xE0,0x4F,0xF0,0x5F,0xF8,0x7C,0xF8,0x7C,0xF8,0x7C,0xF8,0x7F,0xF8,0x7F,0xF0,0x7F,0xE0,0x7C,0x00,0x7C,0x00,0x3C,0x00,
+    0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x3F,0xF0,0x4F,0xF8,0x5F,0xF1,0x7E,0x02,0x7E,0x02,0x7F,0xFB,0x7F,0xFB,0x7E,0x03,0x7E,0x03,0x7F,0xF3,
+    0x7F,0xFB,0x3F,0xF1,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xC3,0x0E,0x67,0x93,0xE7,0x97,0xFF,0x9F,0xFF,0x9F,0xFF,0x9F,0xE7,0x9F,
+    0xE7,0x9F,0xE7,0x8F,0xC3,0x07,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x10,0xE0,0x39,0x30,0x39,0x70,0x39,0xF0,0x39,0xF0,0x39,0xF0,
+    0x39,0xF0,0xF9,0xFE,0xF1,0xFF,0xE0,0xFE,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x1F,0x83,0x1F,0xC4,0x5F,0xE5,0x7C,0xE0,0x7F,0xE0,
+    0x7F,0xE0,0x7C,0xE0,0x7C,0xE0,0x7C,0xE0,0x38,0x40,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0x3F,0xFE,0x3F,0xFE,0xBF,0xF0,0xF9,
+    0xF0,0xF9,0xF0,0xF9,0xF0,0xF9,0xF0,0xFF,0xF0,0x7F,0xF0,0x3F,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x07,0xF0,0x89,0xF8,0xCB,0xFC,
+    0xCF,0x9C,0xCF,0xF8,0xCF,0xF0,0xCF,0xF8,0xCF,0xBC,0x8F,0x9C,0x07,0x08,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x61,0x00,0x31,
+    0x01,0xE7,0x01,0xC7,0x03,0xC7,0x03,0xC7,0x01,0xC7,0x01,0xE7,0x01,0xF7,0x00,0x61,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0x60,
+    0xFE,0xB0,0xC0,0x7C,0xC0,0x3C,0xC0,0x3C,0xC0,0x3C,0xC0,0x3C,0xFC,0xB0,0xFE,0xF0,0xFC,0x60,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+    0x00,0x3F,0x00,0x4F,0x00,0x5F,0x00,0x01,0x00,0x5F,0x00,0x7C,0x00,0x7F,0x00,0x7F,0x00,0x7F,0x00,0x3F,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+    0x00,0x00,0x83,0xF0,0xC3,0xF9,0xEF,0x9D,0xEF,0x9C,0xAF,0x9D,0x0F,0x9D,0xCF,0x9D,0xEF,0xFD,0xEF,0xFD,0xC3,0xF0,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+    0x00,0x00,0x00,0x00,0xFE,0x0F,0x3F,0x13,0x7F,0x97,0x07,0x80,0x7E,0x97,0xF0,0x1F,0xFF,0x1F,0xFF,0x9F,0xFF,0x9F,0xFF,0x0F,0x00,0x00,0x00,0x00,0x00,0x00,
+    0x00,0x00,0x00,0x00,0x00,0x00,0xE0,0x00,0xF0,0x00,0xF8,0x00,0x78,0x00,0xE8,0x00,0x00,0x00,0xF0,0x00,0xF8,0x00,0xF8,0x00,0xF0,0x00,0x00,0x00,0x00,0x00,
+    0x00,0x00,0x00,0x00,0x00,0x00,0x03,0x82,0x04,0xC2,0x05,0xC3,0x07,0xC3,0x07,0xC3,0x07,0xC3,0x07,0xC3,0x07,0xFB,0x07,0xFF,0x03,0xF9,0x00,0x00,0x00,0x00,
+    0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xFF,0x1F,0xFF,0x1F,0xE0,0x7F,0xE1,0x7C,0xFF,0x3F,0xE1,0x01,0xE0,0x3F,0xFE,0x7F,0xFF,0x7F,0xFE,0x3F,0x00,0x00,
+    0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xC0,0x01,0xE0,0x01,0xC0,0x01,0x00,0x01,0xC0,0x01,0xE0,0x01,0xE0,0x01,0xE0,0x01,0xE0,0x01,0x80,0x00,
+    0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x7F,0x8F,0x7F,0x8F,0xF0,0x3E,0xF0,0xBE,0xFF,0xBF,0xFF,0x3E,0xF0,0x3E,0xF0,0x3E,0xF0,0x3E,
+    0xE0,0x1C,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xC5,0xFC,0xC5,0xFE,0x77,0xCE,0x77,0xCE,0xF7,0xFC,0x77,0xF8,0x77,0xFC,0x77,0xDE,
+    0x77,0xCE,0x23,0x84,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xBF,0x8B,0xBF,0xCB,0xF9,0xCF,0xF9,0xCF,0xFF,0x8F,0xFF,0x0F,0xFF,0x8F,
+    0xFB,0xCF,0xF9,0xCF,0x70,0x87,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0x70,0xFC,0x98,0x80,0xB8,0x84,0xF8,0xFC,0xF8,0x84,0xF8,
+    0x80,0xF8,0xF8,0xFF,0xFC,0xFF,0xF8,0x7F,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x0E,0x00,0x13,0x00,0x17,0x00,0x1F,0x00,0x1F,0x00,
+    0x1F,0x00,0x1F,0x00,0x1F,0xE0,0x9F,0xF0,0x0F,0xE0,0x00,0x00,0x00,0x00
+};
+
+// The cycles each kind of instruction takes under a timing model, on top of
+// Fetch. Skips cost the same whether they skip or not.
+typedef struct Chip8_TimingModel
+{
+  int CyclesPerSecond;        // Clock the 60Hz events are spaced for, 0 to keep the machine's speed.
+  unsigned short VBlank;      // Cycles the display takes from the program each frame.
+  unsigned short Fetch;       // Fetching and decoding any instruction.
+  unsigned short Screen;      // 00E0, 00CN, 00FB and 00FC, which rewrite the whole display.
+  unsigned short Return;      // 00EE.
+  unsigned short Mode;        // 00FD, 00FE and 00FF.
+  unsigned short Jump;        // 1NNN.
+  unsigned short Call;        // 2NNN.
+  unsigned short SkipByte;    // 3XKK and 4XKK.
+  unsigned short SkipReg;     // 5XY0 and 9XY0.
+  unsigned short Load;        // 6XKK.
+  unsigned short Add;         // 7XKK.
+  unsigned short Move;        // 8XY0.
+  unsigned short Logic;       // 8XY1, 8XY2 and 8XY3.
+  unsigned short Arith;       // 8XY4 to 8XYE.
+  unsigned short Index;       // ANNN.
+  unsigned short JumpOffset;  // BNNN.
+  unsigned short Random;      // CXKK.
+  unsigned short Draw;        // DXYN, before any rows.
+  unsigned short DrawRow;     // DXYN, each byte of sprite drawn, charged as the sprite is drawn.
+  unsigned short Unaligned;   // DXYN, each row of a sprite not on a byte boundary.
+  unsigned short KeySkip;     // EX9E and EXA1.
+  unsigned short Timer;       // FX07, FX15 and FX18.
+  unsigned short KeyWait;     // FX0A, each time it looks for a key.
+  unsigned short AddIndex;    // FX1E.
+  unsigned short Font;        // FX29 and FX30.
+  unsigned short Decimal;     // FX33.
+  unsigned short Memory;      // FX55, FX65, FX75 and FX85, before any registers.
+  unsigned short Register;    // FX55, FX65, FX75 and FX85, each register copied.
+} Chip8_TimingModel;
+
+static const Chip8_TimingModel Chip8_TimingModels[CHIP8_TIMING_COUNT] = {
+    // Flat, one cycle an instruction at whatever speed the machine is set to.
+    {.Fetch = 1},
+
+    // COSMAC VIP, machine cycles of the 1802 at 1.7609MHz / 8. The display's DMA takes
+    // 8 bytes on each of its 128 lines a frame. Approximations of the original
+    // interpreter's routines, the SuperChip instructions it lacks cost like their nearest.
+    {.CyclesPerSecond = 220113, .VBlank = 1024, .Fetch = 40,
+     .Screen = 3078, .Return = 10, .Mode = 24, .Jump = 12, .Call = 26,
+     .SkipByte = 10, .SkipReg = 14, .Load = 6, .Add = 10, .Move = 12, .Logic = 44, .Arith = 44,
+     .Index = 12, .JumpOffset = 22, .Random = 36, .Draw = 26, .DrawRow = 46, .Unaligned = 22,
+     .KeySkip = 14, .Timer = 10, .KeyWait = 20, .AddIndex = 16, .Font = 16, .Decimal = 84,
+     .Memory = 14, .Register = 14},
+
+    // SuperChip on the HP48, in eighths of an ALU instruction at 30 of those a frame.
+    // The HP48 interpreter's drawing and screen copies dominate, everything else is close to level.
+    {.CyclesPerSecond = 14400, .Fetch = 8,
+     .Screen = 24, .Random = 2, .Draw = 4, .DrawRow = 1, .Unaligned = 1,
+     .Decimal = 4, .Register = 1}};
+
+// Cycles every OpCode takes under each model, shared by every machine.
+// They are all built once, the first time any machine picks a model, before any core can read them.
+static unsigned short Chip8_CycleCostTables[CHIP8_TIMING_COUNT][65536];
+#ifdef _WIN32
+static INIT_ONCE Chip8_CycleCostsOnce = INIT_ONCE_STATIC_INIT;
+#else
+static pthread_once_t Chip8_CycleCostsOnce = PTHREAD_ONCE_INIT;
+#endif
+
+// The quirks of each of CHIP8_PROFILES.
+static const int Chip8_ProfileQuirks[CHIP8_PROFILE_COUNT] = {
+    CHIP8_QUIRKS_DEFAULT, CHIP8_QUIRKS_CHIP8, CHIP8_QUIRKS_SCHIP10, CHIP8_QUIRKS_SCHIP11, CHIP8_QUIRKS_XOCHIP};
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_Create
+ * Allocates a new Chip8 Virtual Machine and sets its initial state.
+ *
+ * Parameters:
+ * None.
+ *
+ * Returns:
+ * Chip8_Machine * - The new machine, or NULL if it could not be allocated.
+ */
+Chip8_Machine *Chip8_Create(void)
+{
+  Chip8_Machine *chip8 = calloc(1, sizeof(Chip8_Machine));
+  if (chip8 == NULL)
+  {
+    return NULL;
+  }
+
+  // The core, profile, speed, timing and seed are kept across resets, so pick them here rather than in Chip8_Initialise.
+  chip8->Core = CHIP8_DEFAULT_CORE;
+  chip8->Profile = CHIP8_PROFILE_DEFAULT;
+  chip8->CyclesPerSecond = CHIP8_DEFAULT_SPEED;
+  chip8->RandomSeed = (uint32_t)time(NULL);
+  Chip8_SetTiming(chip8, CHIP8_TIMING_FLAT);
+
+  Chip8_Initialise(chip8);
+  return chip8;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_Destroy
+ * Frees a machine created with Chip8_Create.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to free, may be NULL.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_Destroy(Chip8_Machine *chip8)
+{
+  if (chip8 == NULL)
+  {
+    return;
+  }
+
+  Chip8_JitDestroy(chip8->Jit);
+  free(chip8->PixelTable);
+  free(chip8);
+}
 
-const int CHIP8TICKSPERFRAME = 10;
+//------------------------------------------------------------------------------
 
-double Last_DelayUpdate = 0;
-double LastSoundUpdate = 0;
-double CurrentTime = 0;
+/*
+ * Function: Chip8_FindCompiledROM
+ * Looks for a copy of the ROM just loaded compiled for the machine's profile.
+ * Compiled ROMs are only linked in when building with -DCHIP8_AOT.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine the ROM was loaded into.
+ * int size - The size of the ROM in bytes.
+ *
+ * Returns:
+ * const Chip8_CompiledROM * - The compiled ROM, or NULL if there isn't one.
+ */
+static const Chip8_CompiledROM *Chip8_FindCompiledROM(Chip8_Machine *chip8, int size)
+{
+#ifdef CHIP8_AOT
+  for (int i = 0; Chip8_CompiledROMs[i] != NULL; i++)
+  {
+    const Chip8_CompiledROM *rom = Chip8_CompiledROMs[i];
+    if (rom->Profile == chip8->LoadedProfile && rom->Size == size && memcmp(&chip8->ProgramMemory[0x200], rom->Image, size) == 0)
+    {
+      return rom;
+    }
+  }
+#endif
+  return NULL;
+}
 
 //------------------------------------------------------------------------------
 
 /*
  * Function: Chip8_LoadROM
- * Loads the passed ROM file into program memory.
+ * Loads the passed ROM file into program memory. The ROM runs with the
+ * quirks of chip8->Profile as it is now, until the next ROM is loaded.
  *
  * Parameters:
+ * Chip8_Machine *chip8 - The machine to load into.
  * ROM_FileName - Path to the ROM file.
  *
  * Returns:
  * int - EXIT_SUCCESS or EXIT_FAILURE.
  *
  */
-int Chip8_LoadROM(char *ROM_FileName)
+int Chip8_LoadROM(Chip8_Machine *chip8, char *ROM_FileName)
 {
   FILE *fp;
   unsigned short pos = 512;
   unsigned char ch;
+  int size = 0;
 
   fp = fopen(ROM_FileName, "rb");
   if (fp == NULL)
@@ -66,7 +312,11 @@ int Chip8_LoadROM(char *ROM_FileName)
   while (!feof(fp))
   {
     ch = fgetc(fp);
-    Chip8_ProgramMemory[pos] = ch;
+    if (!feof(fp))
+    {
+      size++;
+    }
+    chip8->ProgramMemory[pos] = ch;
     pos++;
     if (pos >= 4096)
     {
@@ -74,6 +324,22 @@ int Chip8_LoadROM(char *ROM_FileName)
     }
   }
   fclose(fp);
+
+  // Every core picks its instructions for the profile when decoding, so it stays fixed while the ROM runs.
+  chip8->LoadedProfile = (chip8->Profile > 0 && chip8->Profile < CHIP8_PROFILE_COUNT) ? chip8->Profile : CHIP8_PROFILE_DEFAULT;
+  chip8->Quirks = Chip8_ProfileQuirks[chip8->LoadedProfile];
+
+  // Anything decoded or translated from the old program memory or profile is now stale.
+  memset(chip8->DecodeCache, 0, sizeof(chip8->DecodeCache));
+  Chip8_JitFlush(chip8->Jit);
+
+  // Use the compiled code if this ROM was linked into the build.
+  chip8->Compiled = Chip8_FindCompiledROM(chip8, size);
+
+  // Superinstruction statistics are kept per ROM.
+  memset(chip8->FusedSites, 0, sizeof(chip8->FusedSites));
+  memset(chip8->FusedInstructions, 0, sizeof(chip8->FusedInstructions));
+  chip8->IdleInstructions = 0;
   return EXIT_SUCCESS;
 }
 
@@ -81,113 +347,357 @@ int Chip8_LoadROM(char *ROM_FileName)
 
 /*
  * Function: Chip8_Initialise
- * Sets the intial states for the emulator.
+ * Sets (or resets) the intial states for the emulator.
  *
  * Parameters:
- * None.
+ * Chip8_Machine *chip8 - The machine to reset.
  *
  * Returns:
  * void.
  */
-void Chip8_Initialise(void)
+void Chip8_Initialise(Chip8_Machine *chip8)
 {
-  Chip8_ProgramCounter = 0x200; // Program counter.
-  Chip8_IndexRegister = 0;      // Chip8_IndexRegister register.
-  Chip8_DelayTimer = 0;         // Chip8_DelayTimer timer.
-  Chip8_SoundTimer = 0;         // Sound timer.
-  Chip8_StackPointer = 0;       // Stack pointer.
-  Chip8_DrawFlag = 0;           // Reset screen update flag.
-  Chip8_OpCode = 0;             // Current op code.
-  CHIP8_SUPER = 0;              // Default to a Standard Chip8
-
-  CHIP8_SCREENWIDTH = 64;
-  CHIP8_SCREENHEIGHT = 32;
+  chip8->ProgramCounter = 0x200; // Program counter.
+  chip8->RunState = CHIP8_RUNNING; // Not waiting for a key.
+  chip8->IndexRegister = 0;      // Index register.
+  chip8->DelayTimer = 0;         // Delay timer.
+  chip8->SoundTimer = 0;         // Sound timer.
+  chip8->StackPointer = 0;       // Stack pointer.
+  chip8->DrawFlag = 1;           // Redraw the whole screen.
+  chip8->DirtyRows = ~(uint64_t)0;
+  chip8->OpCode = 0;             // Current op code.
+  chip8->Super = 0;              // Default to a Standard Chip8
+  chip8->StopReason = CHIP8_EXIT_BUDGET;
+
+  chip8->ScreenWidth = 64;
+  chip8->ScreenHeight = 32;
+
+  // Start counting cycles again, with only the 60Hz events waiting.
+  chip8->Cycles = 0;
+  chip8->EventCount = 0;
+  chip8->StallCycles = 0;
+  Chip8_SetSpeed(chip8, chip8->CyclesPerSecond);
 
   // Clear the display memory.
-  for (int i = 0; i < 8192; ++i)
-  {
-    Chip8_DisplayMemory[i] = 0;
-  }
+  memset(chip8->DisplayMemory, 0, sizeof(chip8->DisplayMemory));
 
   // Clear stack memory.
   for (int i = 0; i < 16; ++i)
   {
-    Chip8_Stack[i] = 0;
+    chip8->Stack[i] = 0;
   }
 
   // Clear the register and key states.
   for (int i = 0; i < 16; ++i)
   {
-    Chip8_VRegister[i] = 0;
-    Chip8_KeyStates[i] = CHIP8_KEYUP;
+    chip8->VRegister[i] = 0;
+    chip8->KeyStates[i] = CHIP8_KEYUP;
   }
 
   // Clear main program memory.
   for (int i = 0; i < 4096; ++i)
   {
-    Chip8_ProgramMemory[i] = 0;
+    chip8->ProgramMemory[i] = 0;
   }
 
+  // Nothing has been decoded or translated yet.
+  memset(chip8->DecodeCache, 0, sizeof(chip8->DecodeCache));
+  Chip8_JitFlush(chip8->Jit);
+  chip8->Compiled = NULL;
+
   // Load the default Chip-8 font into memory.
   int count = 0;
   for (int i = 0; i < 80; ++i)
   {
-    Chip8_ProgramMemory[i] = Chip8_FontSet[count++];
+    chip8->ProgramMemory[i] = Chip8_FontSet[count++];
   }
 
   // Load the Super Chip extended font into memory.
   count = 0;
   for (int i = 80; i < 240; ++i)
   {
-    Chip8_ProgramMemory[i] = Chip8_SuperFontSet[count++];
+    chip8->ProgramMemory[i] = Chip8_SuperFontSet[count++];
   }
 
   // Load our default splash ROM
   unsigned short pos = 512;
   for (int loop = 0; loop < sizeof(Chip8_LogoRom); loop++)
   {
-    Chip8_ProgramMemory[pos++] = Chip8_LogoRom[loop];
+    chip8->ProgramMemory[pos++] = Chip8_LogoRom[loop];
   }
 
-  // Initialise the random seed.
-  srand(time(NULL));
+  // Restart the random sequence, so a reset replays the same numbers.
+  Chip8_SetSeed(chip8, chip8->RandomSeed);
 }
 
 //------------------------------------------------------------------------------
 
 /*
- * Function: Chip8_DrawScreen
- * If the DrawFlag is set draws the CHIP screen.
+ * Function: Chip8_GetPixel
+ * Reads one pixel of the display.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to read.
+ * int x - Column, 0 to ScreenWidth - 1.
+ * int y - Row, 0 to ScreenHeight - 1.
+ *
+ * Returns:
+ * int - 1 if the pixel is set, otherwise 0.
+ */
+int Chip8_GetPixel(Chip8_Machine *chip8, int x, int y)
+{
+  int bit = x + y * chip8->ScreenWidth;
+  return (chip8->DisplayMemory[bit >> 6] >> (63 - (bit & 63))) & 1;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_DrawScreenFill
+ * If the DrawFlag is set redraws the rows of the CHIP screen that changed,
+ * filling each run of pixels with tigrFill. Used when the lookup table
+ * renderer can't be, and as the reference it is benchmarked against.
  *
  * Parameters:
+ * Chip8_Machine *chip8 - The machine to draw.
  * Tigr *screen.
  *
  * Returns:
- * void.
+ * int - 1 if anything was drawn and the screen needs presenting, otherwise 0.
  */
-void Chip8_DrawScreen(Tigr *screen)
+int Chip8_DrawScreenFill(Chip8_Machine *chip8, Tigr *screen)
 {
-  int PixelWidth = CLIENTWIDTH / CHIP8_SCREENWIDTH;
-  int PixelHeight = CLIENTHEIGHT / CHIP8_SCREENHEIGHT;
+  int PixelWidth = screen->w / chip8->ScreenWidth;
+  int PixelHeight = screen->h / chip8->ScreenHeight;
+
+  // Nothing has changed since the last draw.
+  if (chip8->DrawFlag == 0)
+  {
+    return 0;
+  }
 
-  // If the draw flag is set then update the screen
-  if (Chip8_DrawFlag == 1)
+  for (int row = 0; row < chip8->ScreenHeight; ++row)
   {
-    for (int row = 0; row < CHIP8_SCREENHEIGHT; ++row)
+    if ((chip8->DirtyRows & ((uint64_t)1 << row)) == 0)
     {
-      for (int col = 0; col < CHIP8_SCREENWIDTH; ++col)
+      continue;
+    }
+
+    // Clear the row, then fill each run of set pixels with a single rectangle.
+    tigrFill(screen, 0, row * PixelHeight, chip8->ScreenWidth * PixelWidth, PixelHeight, BACKGROUND);
+
+    int col = 0;
+    while (col < chip8->ScreenWidth)
+    {
+      if (Chip8_GetPixel(chip8, col, row))
       {
-        if (Chip8_DisplayMemory[col + (row * CHIP8_SCREENWIDTH)] != 0)
+        int start = col;
+        while (col < chip8->ScreenWidth && Chip8_GetPixel(chip8, col, row))
         {
-          tigrFill(screen, col * PixelWidth, row * PixelHeight, PixelWidth, PixelHeight, FOREGROUND);
+          col++;
         }
-        else
+        tigrFill(screen, start * PixelWidth, row * PixelHeight, (col - start) * PixelWidth, PixelHeight, FOREGROUND);
+      }
+      else
+      {
+        col++;
+      }
+    }
+  }
+
+  chip8->DirtyRows = 0;
+  chip8->DrawFlag = 0;
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_BuildPixelTable
+ * Builds the renderer's lookup table for a pixel width, if it isn't already built.
+ * Entry n is the row of TPixels that display byte n expands to.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to build the table for.
+ * int PixelWidth - Bitmap pixels per Chip8 pixel.
+ *
+ * Returns:
+ * int - EXIT_SUCCESS, or EXIT_FAILURE if the table could not be allocated.
+ */
+static int Chip8_BuildPixelTable(Chip8_Machine *chip8, int PixelWidth)
+{
+  int Span = 8 * PixelWidth;
+
+  if (chip8->PixelTable != NULL && chip8->PixelTableWidth == PixelWidth)
+  {
+    return EXIT_SUCCESS;
+  }
+
+  free(chip8->PixelTable);
+  chip8->PixelTableWidth = 0;
+  chip8->PixelTable = malloc(256 * Span * sizeof(TPixel));
+  if (chip8->PixelTable == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+
+  for (int value = 0; value < 256; value++)
+  {
+    TPixel *Run = &chip8->PixelTable[value * Span];
+    for (int bit = 0; bit < 8; bit++)
+    {
+      TPixel Colour = (value & (0x80 >> bit)) ? FOREGROUND : BACKGROUND;
+      for (int i = 0; i < PixelWidth; i++)
+      {
+        *Run++ = Colour;
+      }
+    }
+  }
+  chip8->PixelTableWidth = PixelWidth;
+  return EXIT_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_SpreadBits
+ * Spreads the bits of a byte out, bit n moving to bit n * scale.
+ *
+ * Parameters:
+ * unsigned int value - The byte to spread.
+ * int scale - The distance between bits afterwards.
+ *
+ * Returns:
+ * uint32_t - The spread bits.
+ */
+static uint32_t Chip8_SpreadBits(unsigned int value, int scale)
+{
+  uint32_t Bits = 0;
+  for (int bit = 0; bit < 8; bit++)
+  {
+    Bits |= ((value >> bit) & 1) << (bit * scale);
+  }
+  return Bits;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ExpandScanline
+ * Expands a scanline of bits into pixels through the lookup table. The scanline
+ * is given as one row of bits per subcolumn, which are interleaved so pixel x
+ * of subcolumn c lands at x * scale + c.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine whose lookup table is used.
+ * const uint64_t (*columns)[2] - A row of bits for each subcolumn.
+ * int scale - The number of subcolumns.
+ * TPixel *out - Where the scanline's pixels go.
+ *
+ * Returns:
+ * void.
+ */
+static void Chip8_ExpandScanline(Chip8_Machine *chip8, const uint64_t (*columns)[2], int scale, TPixel *out)
+{
+  int Span = 8 * chip8->PixelTableWidth;
+  int Words = chip8->ScreenWidth / 64;
+
+  for (int word = 0; word < Words; word++)
+  {
+    for (int shift = 56; shift >= 0; shift -= 8)
+    {
+      // Interleave a byte from each subcolumn, then look the result up a byte at a time.
+      uint32_t Pixels = (columns[0][word] >> shift) & 0xFF;
+      if (scale > 1)
+      {
+        Pixels = 0;
+        for (int column = 0; column < scale; column++)
         {
-          tigrFill(screen, col * PixelWidth, row * PixelHeight, PixelWidth, PixelHeight, BACKGROUND);
+          Pixels |= Chip8_SpreadBits((columns[column][word] >> shift) & 0xFF, scale) << (scale - 1 - column);
         }
       }
+
+      for (int part = scale - 1; part >= 0; part--)
+      {
+        memcpy(out, &chip8->PixelTable[((Pixels >> (part * 8)) & 0xFF) * Span], Span * sizeof(TPixel));
+        out += Span;
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_DrawScreen
+ * If the DrawFlag is set redraws the rows of the CHIP screen that changed.
+ * Each byte of display memory is expanded through a lookup table straight
+ * into the screen's pixels, then the first scanline of the row is copied
+ * down for the rest of its height. Unfiltered, the output matches
+ * Chip8_DrawScreenFill. With a filter the display is scaled up by it first,
+ * the screen needs to be at least the filter's scale times the display size.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to draw.
+ * Tigr *screen.
+ *
+ * Returns:
+ * int - 1 if anything was drawn and the screen needs presenting, otherwise 0.
+ */
+int Chip8_DrawScreen(Chip8_Machine *chip8, Tigr *screen)
+{
+  int Scale = Chip8_FilterScale(chip8->Filter);
+  int PixelWidth = screen->w / (chip8->ScreenWidth * Scale);
+  int PixelHeight = screen->h / (chip8->ScreenHeight * Scale);
+  int RowWidth = chip8->ScreenWidth * Scale * PixelWidth;
+  uint64_t Dirty = chip8->DirtyRows;
+  Chip8_FilteredRow Filtered;
+
+  // Nothing has changed since the last draw.
+  if (chip8->DrawFlag == 0)
+  {
+    return 0;
+  }
+
+  // Fall back if the screen is smaller than the display or the table can't be built.
+  if (PixelWidth <= 0 || PixelHeight <= 0 ||
+      Chip8_BuildPixelTable(chip8, PixelWidth) != EXIT_SUCCESS)
+  {
+    return Chip8_DrawScreenFill(chip8, screen);
+  }
+
+  // A filtered row also depends on the rows either side of it.
+  if (Scale > 1)
+  {
+    Dirty |= (Dirty << 1) | (Dirty >> 1);
+  }
+
+  for (int row = 0; row < chip8->ScreenHeight; ++row)
+  {
+    if ((Dirty & ((uint64_t)1 << row)) == 0)
+    {
+      continue;
+    }
+
+    Chip8_FilterRow(chip8, chip8->Filter, row, &Filtered);
+
+    for (int subrow = 0; subrow < Scale; subrow++)
+    {
+      // Expand the row into its first scanline.
+      TPixel *Scanline = &screen->pix[(row * Scale + subrow) * PixelHeight * screen->w];
+      Chip8_ExpandScanline(chip8, Filtered.Rows[subrow], Scale, Scanline);
+
+      // Copy it down for the rest of the row's height.
+      for (int line = 1; line < PixelHeight; line++)
+      {
+        memcpy(Scanline + line * screen->w, Scanline, RowWidth * sizeof(TPixel));
+      }
     }
   }
+
+  chip8->DirtyRows = 0;
+  chip8->DrawFlag = 0;
+  return 1;
 }
 
 //------------------------------------------------------------------------------
@@ -197,12 +707,12 @@ void Chip8_DrawScreen(Tigr *screen)
  * Shows the current state of the emulator Registers, Stack, Program Counter, etc.
  *
  * Parameters:
- * None.
+ * Chip8_Machine *chip8 - The machine to show.
  *
  * Returns:
  * void.
  */
-void Chip8_ShowProgramState(void)
+void Chip8_ShowProgramState(Chip8_Machine *chip8)
 {
   int i = 0;
   int y = 40;
@@ -210,25 +720,25 @@ void Chip8_ShowProgramState(void)
 
   Console_SetXY(1, 1);
 
-  sprintf(string, "PC : %d\t", Chip8_ProgramCounter);
+  sprintf(string, "PC : %d\t", chip8->ProgramCounter);
   Console_TextXY(string, 1, 1);
 
-  sprintf(string, "SP : %d\t", Chip8_StackPointer);
+  sprintf(string, "SP : %d\t", chip8->StackPointer);
   Console_TextXY(string, 1, 2);
 
-  sprintf(string, "Index : %d\t", Chip8_IndexRegister);
+  sprintf(string, "Index : %d\t", chip8->IndexRegister);
   Console_TextXY(string, 1, 3);
 
-  sprintf(string, "Delay : %d\t", Chip8_DelayTimer);
+  sprintf(string, "Delay : %d\t", chip8->DelayTimer);
   Console_TextXY(string, 20, 2);
 
-  sprintf(string, "Sound : %d\t", Chip8_SoundTimer);
+  sprintf(string, "Sound : %d\t", chip8->SoundTimer);
   Console_TextXY(string, 20, 3);
 
   y = 5;
   for (i = 0; i < 16; i++)
   {
-    sprintf(string, "V[%02d] : %02d\t", i, Chip8_VRegister[i]);
+    sprintf(string, "V[%02d] : %02d\t", i, chip8->VRegister[i]);
     Console_TextXY(string, 1, y);
     y = y + 1;
   }
@@ -236,7 +746,7 @@ void Chip8_ShowProgramState(void)
   y = 5;
   for (i = 0; i < 16; i++)
   {
-    sprintf(string, "Stack[%02d] : %02d\t", i, Chip8_Stack[i]);
+    sprintf(string, "Stack[%02d] : %02d\t", i, chip8->Stack[i]);
     Console_TextXY(string, 20, y);
     y = y + 1;
   }
@@ -244,36 +754,72 @@ void Chip8_ShowProgramState(void)
   y = 5;
   for (i = 0; i < 16; i++)
   {
-    sprintf(string, "Key [%02d] : %02d\t", i, Chip8_KeyStates[i]);
+    sprintf(string, "Key [%02d] : %02d\t", i, chip8->KeyStates[i]);
     Console_TextXY(string, 40, y + i);
   }
 }
 
 //------------------------------------------------------------------------------
 
-void Chip8_Disassemble(void)
+/*
+ * Function: Chip8_ShowFusionStats
+ * Prints how many superinstructions the current ROM decoded to and how many
+ * instructions ran inside them.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to report on.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_ShowFusionStats(Chip8_Machine *chip8)
+{
+  static const char *Names[CHIP8_FUSE_COUNT] = {
+      "6XKK 6YKK DXYN",
+      "ANNN DXYN",
+      "7XKK 3XKK 1NNN",
+      "FX07 3X00 1NNN",
+      "EXKK 1NNN",
+      "1NNN"};
+  unsigned long total = 0;
+
+  printf("Superinstructions:\n");
+  for (int i = 0; i < CHIP8_FUSE_COUNT; i++)
+  {
+    printf("  %-16s %6lu sites %12lu instructions\n", Names[i], chip8->FusedSites[i], chip8->FusedInstructions[i]);
+    total += chip8->FusedInstructions[i];
+  }
+  printf("  %-16s %6s       %12lu instructions\n", "Total", "", total);
+  printf("  %-16s %6s       %12lu instructions\n", "Skipped idle", "", chip8->IdleInstructions);
+}
+
+//------------------------------------------------------------------------------
+
+void Chip8_Disassemble(Chip8_Machine *chip8)
 {
   char string[100];
   char OpCode[100];
 
-  // Grab the next Chip8_OpCode.
-  Chip8_OpCode = ((Chip8_ProgramMemory[Chip8_ProgramCounter] << 8) + Chip8_ProgramMemory[Chip8_ProgramCounter + 1]);
+  // Grab the next OpCode.
+  unsigned char High = chip8->ProgramMemory[chip8->ProgramCounter & 0xFFF];
+  unsigned char Low = chip8->ProgramMemory[(chip8->ProgramCounter + 1) & 0xFFF];
+  chip8->OpCode = (High << 8) + Low;
 
-  sprintf(OpCode, "%04X: %04X - [%3d, %3d]  : ", Chip8_ProgramCounter, Chip8_OpCode, Chip8_ProgramMemory[Chip8_ProgramCounter], Chip8_ProgramMemory[Chip8_ProgramCounter + 1]);
+  sprintf(OpCode, "%04X: %04X - [%3d, %3d]  : ", chip8->ProgramCounter, chip8->OpCode, High, Low);
 
   // Extract the most common values from the OpCode
-  int x = (Chip8_OpCode & 0x0F00) >> 8;
-  int y = (Chip8_OpCode & 0x00F0) >> 4;
-  int n = (Chip8_OpCode & 0x000F);
-  int kk = (Chip8_OpCode & 0x00FF);
-  int nnn = (Chip8_OpCode & 0x0FFF);
-
-  // Process the Chip8_OpCode.
-  switch (Chip8_OpCode & 0xF000)
+  int x = (chip8->OpCode & 0x0F00) >> 8;
+  int y = (chip8->OpCode & 0x00F0) >> 4;
+  int n = (chip8->OpCode & 0x000F);
+  int kk = (chip8->OpCode & 0x00FF);
+  int nnn = (chip8->OpCode & 0x0FFF);
+
+  // Process the OpCode.
+  switch (chip8->OpCode & 0xF000)
   {
 
   case 0x0000:
-    switch (Chip8_OpCode & 0x00F0)
+    switch (chip8->OpCode & 0x00F0)
     {
 
     // 000CN - Scroll down
@@ -282,7 +828,7 @@ void Chip8_Disassemble(void)
       break;
     }
 
-    switch (Chip8_OpCode & 0x00FF)
+    switch (chip8->OpCode & 0x00FF)
     {
 
     // 00E0 - CLS
@@ -361,7 +907,7 @@ void Chip8_Disassemble(void)
     break;
 
   case 0x8000:
-    switch (Chip8_OpCode & 0x000F)
+    switch (chip8->OpCode & 0x000F)
     {
 
     // 8XY0 - LD Vx, Vy
@@ -410,7 +956,7 @@ void Chip8_Disassemble(void)
       break;
 
     default:
-      sprintf(string, "Unknown Op Code: %04X\n", Chip8_OpCode);
+      sprintf(string, "Unknown Op Code: %04X\n", chip8->OpCode);
       break;
     }
     break;
@@ -441,7 +987,7 @@ void Chip8_Disassemble(void)
     break;
 
   case 0xE000:
-    switch (Chip8_OpCode & 0x00FF)
+    switch (chip8->OpCode & 0x00FF)
     {
     // EX9E - SKP Vx
     case 0x009E:
@@ -454,16 +1000,16 @@ void Chip8_Disassemble(void)
       break;
 
     default:
-      sprintf(string, "Unknown Op Code: %04X\n", Chip8_OpCode);
+      sprintf(string, "Unknown Op Code: %04X\n", chip8->OpCode);
       break;
     }
     break;
 
   case 0xF000:
-    switch (Chip8_OpCode & 0x00FF)
+    switch (chip8->OpCode & 0x00FF)
     {
 
-    // Fx07 - LD Vx, Chip8_DelayTimer
+    // Fx07 - LD Vx, DelayTimer
     case 0x0007:
       sprintf(string, "FX07 - LD V[%d], Delay\n", x);
       break;
@@ -473,12 +1019,12 @@ void Chip8_Disassemble(void)
       sprintf(string, "FX0A - LD V[%d], K\n", x);
       break;
 
-    // Fx15 - LD Chip8_DelayTimer, Vx
+    // Fx15 - LD DelayTimer, Vx
     case 0x0015:
       sprintf(string, "FX15 - LD Delay, V[%d]\n", x);
       break;
 
-    // Fx18 - LD Chip8_SoundTimer, Vx
+    // Fx18 - LD SoundTimer, Vx
     case 0x0018:
       sprintf(string, "FX18 - LD Sound, V[%d]\n", x);
       break;
@@ -503,7 +1049,7 @@ void Chip8_Disassemble(void)
       sprintf(string, "FX33 - LD B, V[%d]\n", x);
       break;
 
-    // FX55 - LD [Chip8_IndexRegister], Vx
+    // FX55 - LD [IndexRegister], Vx
     case 0x0055:
       sprintf(string, "FX55 - LD I, V[%d]\n", x);
       break;
@@ -524,7 +1070,7 @@ void Chip8_Disassemble(void)
       break;
 
     default:
-      sprintf(string, "Unknown Op Code: %04X\n", Chip8_OpCode);
+      sprintf(string, "Unknown Op Code: %04X\n", chip8->OpCode);
       break;
     }
     break;
@@ -538,932 +1084,2068 @@ void Chip8_Disassemble(void)
 //------------------------------------------------------------------------------
 
 /*
- * Function: Chip8_EmulateCPU
- * Emulates one cycle of the Chip8 CPU.
+ * Function: Chip8_InvalidateDecodeCache
+ * Throws away any pre-decoded instructions or translated blocks that overlap
+ * the given bytes of program memory. Compiled ROMs can't be patched, so a
+ * write to compiled code drops back to the interpreter until the next load.
+ * Must be called whenever the CPU writes to program memory.
  *
  * Parameters:
- * void.
+ * Chip8_Machine *chip8 - The machine that was written to.
+ * unsigned short address - The first byte written.
+ * int length - The number of bytes written.
  *
  * Returns:
  * void.
  */
-void Chip8_EmulateCPU(void)
+static void Chip8_InvalidateDecodeCache(Chip8_Machine *chip8, unsigned short address, int length)
 {
-  int keyPress = 0;
+  // An instruction that starts one byte before the write also reads the first written byte,
+  // and a superinstruction reads the instructions that follow it. A superinstruction also runs
+  // the handlers of the entries that follow it, so any whose sequence reaches a cleared entry goes too.
+  for (int i = 1 - 2 * CHIP8_FUSE_MAXLENGTH - 2 * (CHIP8_FUSE_MAXLENGTH - 1); i < length; i++)
+  {
+    chip8->DecodeCache[(address + i) & 0xFFF].Handler = NULL;
 
-  unsigned char Destination[8192] = {0};
+    if (i >= -1 && chip8->Compiled != NULL && chip8->Compiled->Blocks[(address + i) & 0xFFF] != NULL)
+    {
+      chip8->Compiled = NULL;
+    }
+  }
+  Chip8_JitInvalidate(chip8->Jit, address, length);
+}
 
-  // Grab the next Chip8_OpCode.
-  Chip8_OpCode = ((Chip8_ProgramMemory[Chip8_ProgramCounter] << 8) + Chip8_ProgramMemory[Chip8_ProgramCounter + 1]);
+//------------------------------------------------------------------------------
 
-  // Extract the most common values from the OpCode
-  int x = (Chip8_OpCode & 0x0F00) >> 8;
-  int y = (Chip8_OpCode & 0x00F0) >> 4;
-  int n = (Chip8_OpCode & 0x000F);
-  int kk = (Chip8_OpCode & 0x00FF);
-  int nnn = (Chip8_OpCode & 0x0FFF);
+// Scrolling only keeps the visible screen, anything past it in display memory is cleared.
+static void Chip8_ClearOffScreen(Chip8_Machine *chip8)
+{
+  int Visible = (chip8->ScreenWidth * chip8->ScreenHeight) / 64;
+  memset(&chip8->DisplayMemory[Visible], 0, sizeof(chip8->DisplayMemory) - Visible * sizeof(uint64_t));
+}
 
-  // Process the Chip8_OpCode.
-  switch (Chip8_OpCode & 0xF000)
-  {
+// Marks display rows as changed so Chip8_DrawScreen redraws them.
+static inline void Chip8_MarkDirty(Chip8_Machine *chip8, uint64_t rows)
+{
+  chip8->DirtyRows |= rows;
+  chip8->DrawFlag = 1;
+}
 
-  case 0x0000:
-    switch (Chip8_OpCode & 0x00F0)
-    {
-    // 000C - Scroll Down n lines
-    case 0x0C0:
-      for (int loop = 0; loop < 8192; loop++)
-      {
-        Destination[loop] = 0;
-      }
-      for (int col = 0; col < CHIP8_SCREENWIDTH; col++)
-      {
-        for (int row = 0; row < CHIP8_SCREENHEIGHT - n; row++)
-        {
-          int Source = col + (row * (CHIP8_SCREENWIDTH));
-          int Dest = col + ((row + n) * (CHIP8_SCREENWIDTH));
-          Destination[Dest] = Chip8_DisplayMemory[Source];
-        }
-      }
-      for (int loop = 0; loop < 8192; loop++)
-      {
-        Chip8_DisplayMemory[loop] = Destination[loop];
-      }
-      Chip8_ProgramCounter += 2;
-      break;
-    }
+// Rotates a row of 64 pixels right, pixels pushed off the right edge wrap to the left.
+static inline uint64_t Chip8_RotateRight(uint64_t value, int count)
+{
+  return count ? (value >> count) | (value << (64 - count)) : value;
+}
 
-    switch (Chip8_OpCode & 0x00FF)
-    {
+// Unknown or unsupported OpCode, stops the run without moving the program counter.
+static void Chip8_OpUnknown(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  chip8->StopReason = CHIP8_EXIT_INVALID;
+}
 
-    // 00E0 - CLS
-    case 0x00E0:
-      // Clear the display.
-      for (int c = 0; c < 8192; c++)
-      {
-        Chip8_DisplayMemory[c] = 0;
-      }
-      Chip8_DrawFlag = 1;
-      Chip8_ProgramCounter += 2;
-      break;
+// 00CN - Scroll Down n lines
+static void Chip8_Op00CN(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  int Words = chip8->ScreenWidth / 64;
+  int Height = chip8->ScreenHeight;
+  int Lines = ins->n < Height ? ins->n : Height;
+
+  // Move the rows down in place and clear the ones scrolled in at the top.
+  memmove(&chip8->DisplayMemory[Lines * Words], chip8->DisplayMemory, (Height - Lines) * Words * sizeof(uint64_t));
+  memset(chip8->DisplayMemory, 0, Lines * Words * sizeof(uint64_t));
+  Chip8_ClearOffScreen(chip8);
+  Chip8_MarkDirty(chip8, ~(uint64_t)0);
+  chip8->ProgramCounter += 2;
+}
 
-    // 00EE - RET Return from a subroutine.
-    case 0x00EE:
-      // Sets the program counter to the address at the top of the stack, then subtracts 1 from the stack pointer.
-      Chip8_ProgramCounter = Chip8_Stack[--Chip8_StackPointer];
-      // Chip8_StackPointer--;
-      Chip8_ProgramCounter += 2;
-      break;
+// 00E0 - CLS
+static void Chip8_Op00E0(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Clear the display.
+  memset(chip8->DisplayMemory, 0, sizeof(chip8->DisplayMemory));
+  Chip8_MarkDirty(chip8, ~(uint64_t)0);
+  chip8->ProgramCounter += 2;
+}
 
-    // 00FB - Scroll Right 4 Pixels.
-    case 0x00FB:
-      for (int loop = 0; loop < 8192; loop++)
-      {
-        Destination[loop] = 0;
-      }
-      for (int col = 0; col < CHIP8_SCREENWIDTH - 4; col++)
-      {
-        for (int row = 0; row < CHIP8_SCREENHEIGHT; row++)
-        {
-          int Source = col + (row * (CHIP8_SCREENWIDTH));
-          int Dest = (col + 4) + (row * (CHIP8_SCREENWIDTH));
-          Destination[Dest] = Chip8_DisplayMemory[Source];
-        }
-      }
-      for (int loop = 0; loop < 8192; loop++)
-      {
-        Chip8_DisplayMemory[loop] = Destination[loop];
-      }
-      Chip8_DrawFlag = 1;
-      Chip8_ProgramCounter += 2;
-      break;
+// 00EE - RET Return from a subroutine.
+static void Chip8_Op00EE(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Sets the program counter to the address at the top of the stack, then subtracts 1 from the stack pointer.
+  // The stack pointer wraps within the 16 entries, so a ROM can't return or call its way out of the stack.
+  chip8->StackPointer = (chip8->StackPointer - 1) & 0xF;
+  chip8->ProgramCounter = chip8->Stack[chip8->StackPointer];
+  chip8->ProgramCounter += 2;
+}
 
-    // 00FC - Scroll Left 4 Pixels.
-    case 0x00FC:
-      for (int loop = 0; loop < 8192; loop++)
-      {
-        Destination[loop] = 0;
-      }
-      for (int col = 4; col < CHIP8_SCREENWIDTH; col++)
-      {
-        for (int row = 0; row < CHIP8_SCREENHEIGHT; row++)
-        {
-          int Source = col + (row * (CHIP8_SCREENWIDTH));
-          int Dest = (col - 4) + (row * (CHIP8_SCREENWIDTH));
-          Destination[Dest] = Chip8_DisplayMemory[Source];
-        }
-      }
-      for (int loop = 0; loop < 8192; loop++)
-      {
-        Chip8_DisplayMemory[loop] = Destination[loop];
-      }
-      Chip8_DrawFlag = 1;
-      Chip8_ProgramCounter += 2;
-      break;
+// 00FB - Scroll Right 4 Pixels.
+static void Chip8_Op00FB(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Shift each row right in place, the 4 pixels scrolled in on the left are cleared.
+  for (int row = 0; row < chip8->ScreenHeight; row++)
+  {
+    if (chip8->ScreenWidth == 64)
+    {
+      chip8->DisplayMemory[row] >>= 4;
+    }
+    else
+    {
+      uint64_t *Line = &chip8->DisplayMemory[row * 2];
+      Line[1] = (Line[1] >> 4) | (Line[0] << 60);
+      Line[0] >>= 4;
+    }
+  }
+  Chip8_ClearOffScreen(chip8);
+  Chip8_MarkDirty(chip8, ~(uint64_t)0);
+  chip8->ProgramCounter += 2;
+}
 
-    // 0x00FD - Exit the Chip8 Interpreter
-    case 0x00FD:
-      Chip8_Initialise();
-      break;
+// 00FC - Scroll Left 4 Pixels.
+static void Chip8_Op00FC(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Shift each row left in place, the 4 pixels scrolled in on the right are cleared.
+  for (int row = 0; row < chip8->ScreenHeight; row++)
+  {
+    if (chip8->ScreenWidth == 64)
+    {
+      chip8->DisplayMemory[row] <<= 4;
+    }
+    else
+    {
+      uint64_t *Line = &chip8->DisplayMemory[row * 2];
+      Line[0] = (Line[0] << 4) | (Line[1] >> 60);
+      Line[1] <<= 4;
+    }
+  }
+  Chip8_ClearOffScreen(chip8);
+  Chip8_MarkDirty(chip8, ~(uint64_t)0);
+  chip8->ProgramCounter += 2;
+}
 
-    // 0x00FE - Disable Super Chip Mode
-    case 0x00FE:
-      CHIP8_SUPER = 0;
-      CHIP8_SCREENWIDTH = 64;
-      CHIP8_SCREENHEIGHT = 32;
-      Chip8_ProgramCounter += 2;
-      break;
+// 00FD - Exit the Chip8 Interpreter, the machine stays stopped on it until it is reset.
+static void Chip8_Op00FD(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  chip8->RunState = CHIP8_EXITED;
+  chip8->StopReason = CHIP8_EXIT_EXIT;
+}
 
-    // 0x00FF - Enable Super Chip Mode
-    case 0x00FF:
-      CHIP8_SUPER = 1;
-      CHIP8_SCREENWIDTH = 128;
-      CHIP8_SCREENHEIGHT = 64;
-      Chip8_ProgramCounter += 2;
-      break;
+// 00FE - Disable Super Chip Mode
+static void Chip8_Op00FE(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  chip8->Super = 0;
+  chip8->ScreenWidth = 64;
+  chip8->ScreenHeight = 32;
+  Chip8_MarkDirty(chip8, ~(uint64_t)0);
+  chip8->ProgramCounter += 2;
+}
 
-    default:
-      break;
-    }
-    break;
+// 00FF - Enable Super Chip Mode
+static void Chip8_Op00FF(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  chip8->Super = 1;
+  chip8->ScreenWidth = 128;
+  chip8->ScreenHeight = 64;
+  Chip8_MarkDirty(chip8, ~(uint64_t)0);
+  chip8->ProgramCounter += 2;
+}
 
-  // 1NNN - JP nnn Jump to location nnn.
-  case 0x1000:
-    // The interpreter sets the program counter to nnn.
-    Chip8_ProgramCounter = nnn;
-    break;
+// 1NNN - JP nnn Jump to location nnn.
+static void Chip8_Op1NNN(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // The interpreter sets the program counter to nnn.
+  chip8->ProgramCounter = ins->nnn;
+}
 
-  // 2NNN - CALL addr
-  case 0x2000:
-    // Put the Chip8_ProgramCounter value the top of the stack.
-    Chip8_Stack[Chip8_StackPointer] = Chip8_ProgramCounter;
+// 2NNN - CALL addr
+static void Chip8_Op2NNN(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Put the ProgramCounter value the top of the stack.
+  chip8->Stack[chip8->StackPointer] = chip8->ProgramCounter;
 
-    // The interpreter increments the stack pointer
-    Chip8_StackPointer++;
+  // The interpreter increments the stack pointer
+  chip8->StackPointer = (chip8->StackPointer + 1) & 0xF;
 
-    // The Chip8_ProgramCounter is then set to nnn.
-    Chip8_ProgramCounter = nnn;
-    break;
+  // The ProgramCounter is then set to nnn.
+  chip8->ProgramCounter = ins->nnn;
+}
 
-  // 3XKK - SE Vx, kk
-  case 0x3000:
-    // The interpreter compares register Vx to kk
-    if (Chip8_VRegister[x] == kk)
-    {
-      // if they are equal increments the program counter by 2.
-      Chip8_ProgramCounter += 2;
-    }
-    Chip8_ProgramCounter += 2;
-    break;
+// 3XKK - SE Vx, kk
+static void Chip8_Op3XKK(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // The interpreter compares register Vx to kk
+  if (chip8->VRegister[ins->x] == ins->kk)
+  {
+    // if they are equal increments the program counter by 2.
+    chip8->ProgramCounter += 2;
+  }
+  chip8->ProgramCounter += 2;
+}
 
-  // 4XKK - SNE Vx, byte
-  case 0x4000:
-    // Skip next instruction if Vx != kk.
-    if (Chip8_VRegister[x] != kk)
-    {
-      // increments the program counter by 2.
-      Chip8_ProgramCounter += 2;
-    }
-    Chip8_ProgramCounter += 2;
-    break;
+// 4XKK - SNE Vx, byte
+static void Chip8_Op4XKK(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Skip next instruction if Vx != kk.
+  if (chip8->VRegister[ins->x] != ins->kk)
+  {
+    // increments the program counter by 2.
+    chip8->ProgramCounter += 2;
+  }
+  chip8->ProgramCounter += 2;
+}
 
-  // 5XY0 - SE Vx, Vy
-  case 0x5000:
-    // The interpreter compares register Vx to register Vy
-    if (Chip8_VRegister[x] == Chip8_VRegister[y])
-    {
-      // if they are equal, increments the program counter by 2.
-      Chip8_ProgramCounter += 2;
-    }
-    Chip8_ProgramCounter += 2;
-    break;
+// 5XY0 - SE Vx, Vy
+static void Chip8_Op5XY0(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // The interpreter compares register Vx to register Vy
+  if (chip8->VRegister[ins->x] == chip8->VRegister[ins->y])
+  {
+    // if they are equal, increments the program counter by 2.
+    chip8->ProgramCounter += 2;
+  }
+  chip8->ProgramCounter += 2;
+}
 
-  // 6XKK - LD Vx, kk
-  case 0x6000:
-    Chip8_VRegister[x] = kk;
-    Chip8_ProgramCounter += 2;
-    break;
+// 6XKK - LD Vx, kk
+static void Chip8_Op6XKK(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  chip8->VRegister[ins->x] = ins->kk;
+  chip8->ProgramCounter += 2;
+}
 
-  // 7XKK - ADD Vx, kk
-  case 0x7000:
-    Chip8_VRegister[x] += kk;
-    Chip8_ProgramCounter += 2;
-    break;
+// 7XKK - ADD Vx, kk
+static void Chip8_Op7XKK(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  chip8->VRegister[ins->x] += ins->kk;
+  chip8->ProgramCounter += 2;
+}
 
-  case 0x8000:
-    switch (Chip8_OpCode & 0x000F)
-    {
+// 8XY0 - LD Vx, Vy
+static void Chip8_Op8XY0(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  chip8->VRegister[ins->x] = chip8->VRegister[ins->y];
+  chip8->ProgramCounter += 2;
+}
 
-    // 8XY0 - LD Vx, Vy
-    case 0x000:
-      Chip8_VRegister[x] = Chip8_VRegister[y];
-      Chip8_ProgramCounter += 2;
-      break;
+// 8XY1 - OR Vx, Vy
+static void Chip8_Op8XY1(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Performs a bitwise OR on the values of Vx and Vy, then stores the result in Vx.
+  chip8->VRegister[ins->x] |= chip8->VRegister[ins->y];
+  chip8->ProgramCounter += 2;
+}
 
-    // 8XY1 - OR Vx, Vy
-    case 0x001:
-      // Performs a bitwise OR on the values of Vx and Vy, then stores the result in Vx.
-      Chip8_VRegister[x] |= Chip8_VRegister[y];
-      Chip8_ProgramCounter += 2;
-      break;
+// 8XY2 - AND Vx, Vy
+static void Chip8_Op8XY2(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Performs a bitwise AND on the values of Vx and Vy, then stores the result in Vx.
+  chip8->VRegister[ins->x] &= chip8->VRegister[ins->y];
+  chip8->ProgramCounter += 2;
+}
 
-    // 8XY2 - AND Vx, Vy
-    case 0x002:
-      // Performs a bitwise AND on the values of Vx and Vy, then stores the result in Vx.
-      Chip8_VRegister[x] &= Chip8_VRegister[y];
-      Chip8_ProgramCounter += 2;
-      break;
+// 8XY3 - XOR Vx, Vy
+static void Chip8_Op8XY3(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Performs a bitwise exclusive OR on the values of Vx and Vy, then stores the result in Vx.
+  chip8->VRegister[ins->x] ^= chip8->VRegister[ins->y];
+  chip8->ProgramCounter += 2;
+}
 
-    // 8XY3 - XOR Vx, Vy
-    case 0x003:
-      // Performs a bitwise exclusive OR on the values of Vx and Vy, then stores the result in Vx.
-      Chip8_VRegister[x] ^= Chip8_VRegister[y];
-      Chip8_ProgramCounter += 2;
-      break;
+// 8XY4 - ADD Vx, Vy
+static void Chip8_Op8XY4(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // The values of Vx and Vy are added together.
+  // If the result is greater than 8 bits (i.e., > 255,) VF is set to 1, otherwise 0.
+  if (chip8->VRegister[ins->y] > (255 - chip8->VRegister[ins->x]))
+  {
+    chip8->VRegister[0xF] = 1;
+  }
+  else
+  {
+    chip8->VRegister[0xF] = 0;
+  }
+  chip8->VRegister[ins->x] += chip8->VRegister[ins->y];
+  chip8->ProgramCounter += 2;
+}
 
-    // 8XY4 - ADD Vx, Vy
-    case 0x0004:
-      // The values of Vx and Vy are added together.
-      // If the result is greater than 8 bits (i.e., > 255,) VF is set to 1, otherwise 0.
-      if (Chip8_VRegister[y] > (255 - Chip8_VRegister[x]))
-      {
-        Chip8_VRegister[0xF] = 1;
-      }
-      else
-      {
-        Chip8_VRegister[0xF] = 0;
-      }
-      Chip8_VRegister[x] += Chip8_VRegister[y];
-      Chip8_ProgramCounter += 2;
-      break;
+// 8XY5 - SUB Vx, Vy
+static void Chip8_Op8XY5(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // If Vx > Vy, then VF is set to 1, otherwise 0.
+  if (chip8->VRegister[ins->x] >= chip8->VRegister[ins->y])
+  {
+    chip8->VRegister[0xF] = 1;
+  }
+  else
+  {
+    chip8->VRegister[0xF] = 0;
+  }
 
-    // 8XY5 - SUB Vx, Vy
-    case 0x0005:
-      // If Vx > Vy, then VF is set to 1, otherwise 0.
-      // Chip8_VRegister[x] = Chip8_VRegister[x] - Chip8_VRegister[y];
+  // Then Vy is subtracted from Vx, and the results stored in Vx.
+  chip8->VRegister[ins->x] -= chip8->VRegister[ins->y];
+  chip8->ProgramCounter += 2;
+}
 
-      if (Chip8_VRegister[x] >= Chip8_VRegister[y])
-      {
-        Chip8_VRegister[0xF] = 1;
-      }
-      else
-      {
-        Chip8_VRegister[0xF] = 0;
-      }
+// 8XY6 - SHR Vx {, Vy}
+static void Chip8_Op8XY6(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // If the least-significant bit of Vx is 1, then VF is set to 1, otherwise 0. Then Vx is divided by 2.
+  chip8->VRegister[0xF] = chip8->VRegister[ins->x] & 0x1;
+  chip8->VRegister[ins->x] = chip8->VRegister[ins->x] / 2;
+  chip8->ProgramCounter += 2;
+}
 
-      // Then Vy is subtracted from Vx, and the results stored in Vx.
-      Chip8_VRegister[x] -= Chip8_VRegister[y];
-      Chip8_ProgramCounter += 2;
-      break;
+// 8XY6 with CHIP8_QUIRK_SHIFTVY, Vy is copied into Vx and shifted there.
+static void Chip8_Op8XY6Vy(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  chip8->VRegister[ins->x] = chip8->VRegister[ins->y];
+  Chip8_Op8XY6(chip8, ins);
+}
 
-    // 8XY6 - SHR Vx {, Vy}
-    case 0x0006:
-      // If the least-significant bit of Vx is 1, then VF is set to 1, otherwise 0. Then Vx is divided by 2.
-      Chip8_VRegister[0xF] = Chip8_VRegister[x] & 0x1;
-      Chip8_VRegister[x] = Chip8_VRegister[x] / 2;
-      Chip8_ProgramCounter += 2;
-      break;
+// 8XY7 - Subn Vx, Vy
+static void Chip8_Op8XY7(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // If Vy > Vx, then VF is set to 1, otherwise 0. Then Vx is subtracted from Vy, and the results stored in Vx.
+  if (chip8->VRegister[ins->y] >= chip8->VRegister[ins->x])
+  {
+    chip8->VRegister[0xF] = 1;
+  }
+  else
+  {
+    chip8->VRegister[0xF] = 0;
+  }
+  chip8->VRegister[ins->x] = chip8->VRegister[ins->y] - chip8->VRegister[ins->x];
+  chip8->ProgramCounter += 2;
+}
 
-    // 8XY7 - Subn Vx, Vy
-    case 0x0007:
-      // If Vy > Vx, then VF is set to 1, otherwise 0. Then Vx is subtracted from Vy, and the results stored in Vx.
-      if (Chip8_VRegister[y] >= Chip8_VRegister[x])
-      {
-        Chip8_VRegister[0xF] = 1;
-      }
-      else
-      {
-        Chip8_VRegister[0xF] = 0;
-      }
-      Chip8_VRegister[x] = Chip8_VRegister[y] - Chip8_VRegister[x];
-      Chip8_ProgramCounter += 2;
-      break;
+// 8XYE - SHL Vx {, Vy}
+static void Chip8_Op8XYE(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // If the most-significant bit of Vx is 1, then VF is set to 1, otherwise to 0. Then Vx is multiplied by 2.
+  chip8->VRegister[0xF] = chip8->VRegister[ins->x] >> 7;
+  chip8->VRegister[ins->x] = chip8->VRegister[ins->x] * 2;
+  chip8->ProgramCounter += 2;
+}
 
-    // 8XYE - SHL Vx {, Vy}
-    case 0x000E:
-      // If the most-significant bit of Vx is 1, then VF is set to 1, otherwise to 0. Then Vx is multiplied by 2.
-      Chip8_VRegister[0xF] = Chip8_VRegister[x] >> 7;
-      Chip8_VRegister[x] = Chip8_VRegister[x] * 2;
-      Chip8_ProgramCounter += 2;
-      break;
+// 8XYE with CHIP8_QUIRK_SHIFTVY, Vy is copied into Vx and shifted there.
+static void Chip8_Op8XYEVy(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  chip8->VRegister[ins->x] = chip8->VRegister[ins->y];
+  Chip8_Op8XYE(chip8, ins);
+}
 
-    default:
-      break;
-    }
-    break;
+// 9XY0 - SNE Vx, Vy
+static void Chip8_Op9XY0(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // The values of Vx and Vy are compared and if they are not equal, the program counter is increased by 2.
+  if (chip8->VRegister[ins->x] != chip8->VRegister[ins->y])
+  {
+    chip8->ProgramCounter += 2;
+  }
+  chip8->ProgramCounter += 2;
+}
 
-  // 9XY0 - SNE Vx, Vy
-  case 0x9000:
-    // The values of Vx and Vy are compared and if they are not equal, the program counter is increased by 2.
-    if (Chip8_VRegister[x] != Chip8_VRegister[y])
-    {
-      Chip8_ProgramCounter += 2;
-    }
-    Chip8_ProgramCounter += 2;
-    break;
+// ANNN - LD I, addr
+static void Chip8_OpANNN(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Set IndexRegister = nnn.
+  chip8->IndexRegister = ins->nnn;
+  chip8->ProgramCounter += 2;
+}
 
-  // ANNN - LD I, addr
-  case 0xA000:
-    // Set Chip8_IndexRegister = nnn.
-    Chip8_IndexRegister = nnn;
-    Chip8_ProgramCounter += 2;
-    break;
+// BNNN - JP V0, addr
+static void Chip8_OpBNNN(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Jump to location nnn + V0.
+  chip8->ProgramCounter = ins->nnn + chip8->VRegister[0];
+}
 
-  // BNNN - JP V0, addr
-  case 0xB000:
-    // Jump to location nnn + V0.
-    Chip8_ProgramCounter = nnn + Chip8_VRegister[0];
-    break;
+// BXNN - JP Vx, addr with CHIP8_QUIRK_JUMPVX
+static void Chip8_OpBXNN(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Jump to location xnn + Vx.
+  chip8->ProgramCounter = ins->nnn + chip8->VRegister[ins->x];
+}
 
-  // CXKK - RND Vx, byte
-  case 0xC000:
-    // Set Vx = random byte AND kk.
-    Chip8_VRegister[x] = (rand() % 256) & kk;
-    Chip8_ProgramCounter += 2;
-    break;
+// CXKK - RND Vx, byte
+static void Chip8_OpCXKK(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Set Vx = random byte AND kk.
+  chip8->VRegister[ins->x] = Chip8_Random(chip8) & ins->kk;
+  chip8->ProgramCounter += 2;
+}
 
-  // DXYn - DRW Vx, Vy, height
-  // Display n-byte sprite starting at memory location Chip8_IndexRegister at (Vx, Vy), set VF = collision.
-  // The interpreter reads n bytes from memory, starting at the address stored in I.
-  // These bytes are then displayed as sprites on screen at coordinates (Vx, Vy).
-  // Sprites are XORed onto the existing screen.
-  // If this causes any pixels to be erased, VF is set to 1, otherwise it is set to 0.
-  // If the sprite is positioned so part of it is outside the coordinates of the display,
-  // it wraps around to the opposite side of the screen.
-  case 0xD000:
-    Chip8_VRegister[0xF] = 0;
+// DXYn - DRW Vx, Vy, height
+// Display n-byte sprite starting at memory location IndexRegister at (Vx, Vy), set VF = collision.
+// The interpreter reads n bytes from memory, starting at the address stored in I.
+// These bytes are then displayed as sprites on screen at coordinates (Vx, Vy).
+// Sprites are XORed onto the existing screen.
+// If this causes any pixels to be erased, VF is set to 1, otherwise it is set to 0.
+// If the sprite is positioned so part of it is outside the coordinates of the display,
+// it wraps around to the opposite side of the screen, or is cut off with CHIP8_QUIRK_CLIP.
+// The handlers below pass the quirks as constants, so each is built without the others' tests.
+static inline void Chip8_DrawSprite(Chip8_Machine *chip8, const Chip8_Instruction *ins, const int quirks)
+{
+  // SuperChip draws a 16x16 sprite when n is 0, otherwise sprites are 8 pixels wide.
+  int Wide = (chip8->Super != 0 && ins->n == 0);
+  int Height = Wide ? 16 : ins->n;
+  // Latch the coordinates first, VF may be one of them and is reset below.
+  int col = chip8->VRegister[ins->x] % chip8->ScreenWidth;
+  int y = chip8->VRegister[ins->y] % chip8->ScreenHeight;
+
+  // The rows drawn depend on the mode and position, so they are charged here rather than in the cost table.
+  const Chip8_TimingModel *model = chip8->TimingModel;
+  chip8->StallCycles += Height * ((Wide ? 2 : 1) * model->DrawRow + ((col & 7) ? model->Unaligned : 0));
 
-    if (CHIP8_SUPER == 0)
+  chip8->VRegister[0xF] = 0;
+
+  for (int yline = 0; yline < Height; yline++)
+  {
+    // The sprite row, left aligned in a word so it starts in column 0.
+    uint64_t Sprite;
+    if (Wide)
     {
-      for (int yline = 0; yline < n; yline++)
-      {
-        int bitvalue = Chip8_ProgramMemory[Chip8_IndexRegister + yline];
-        for (int xline = 0; xline < 8; xline++)
-        {
-          // Mask off each bit in the bit value.
-          if ((bitvalue & (0x80 >> xline)) != 0)
-          {
-            // Wrap the pixel coordinates using the % operator.
-            int col = (Chip8_VRegister[x] + xline) % CHIP8_SCREENWIDTH;
-            int row = (Chip8_VRegister[y] + yline) % CHIP8_SCREENHEIGHT;
-
-            // Calculate the screen memory address.
-            int address = col + (row * CHIP8_SCREENWIDTH);
-
-            // XOR and set flags as needed.
-            if (Chip8_DisplayMemory[address] == 1)
-            {
-              Chip8_VRegister[0xF] = 1;
-            }
-            Chip8_DisplayMemory[address] ^= 1;
-          }
-        }
-      }
+      Sprite = (uint64_t)((chip8->ProgramMemory[(chip8->IndexRegister + yline * 2) & 0xFFF] * 256) + chip8->ProgramMemory[(chip8->IndexRegister + yline * 2 + 1) & 0xFFF]) << 48;
     }
     else
     {
-      if (n == 0)
-      {
-        // Draw 16x16 sprite
-        int offset = 0;
-        for (int yline = 0; yline < 16; yline++)
-        {
-          unsigned int bitvalue = (Chip8_ProgramMemory[Chip8_IndexRegister + offset] * 256) + (Chip8_ProgramMemory[Chip8_IndexRegister + (offset + 1)]);
-          offset += 2;
-
-          for (int xline = 0; xline < 16; xline++)
-          {
-            // Mask off each bit in the bit value.
-            if ((bitvalue & (0x8000 >> xline)) != 0)
-            {
-              // Wrap the pixel coordinates using the % operator.
-              int col = (Chip8_VRegister[x] + xline) % CHIP8_SCREENWIDTH;
-              int row = (Chip8_VRegister[y] + yline) % CHIP8_SCREENHEIGHT;
-
-              // Calculate the screen memory address.
-              int address = col + (row * CHIP8_SCREENWIDTH);
-
-              // XOR and set flags as needed.
-              if (Chip8_DisplayMemory[address] == 1)
-              {
-                Chip8_VRegister[0xF] = 1;
-              }
-              Chip8_DisplayMemory[address] ^= 1;
-            }
-          }
-        }
-      }
-      else
-      {
-        // Draw 8xN graphic
-        for (int yline = 0; yline < n; yline++)
-        {
-          int bitvalue = Chip8_ProgramMemory[Chip8_IndexRegister + yline];
-          for (int xline = 0; xline < 8; xline++)
-          {
-            // Mask off each bit in the bit value.
-            if ((bitvalue & (0x80 >> xline)) != 0)
-            {
-
-              // Wrap the pixel coordinates using the % operator.
-              int col = (Chip8_VRegister[x] + xline) % CHIP8_SCREENWIDTH;
-              int row = (Chip8_VRegister[y] + yline) % CHIP8_SCREENHEIGHT;
-
-              // Calculate the screen memory address.
-              int address = col + (row * CHIP8_SCREENWIDTH);
-
-              // XOR and set flags as needed.
-              if (Chip8_DisplayMemory[address] == 1)
-              {
-                Chip8_VRegister[0xF] = 1;
-              }
-              Chip8_DisplayMemory[address] ^= 1;
-            }
-          }
-        }
-      }
+      Sprite = (uint64_t)chip8->ProgramMemory[(chip8->IndexRegister + yline) & 0xFFF] << 56;
     }
-    Chip8_DrawFlag = 1;
-    Chip8_ProgramCounter += 2;
-    break;
 
-  case 0xE000:
-    switch (Chip8_OpCode & 0x00FF)
+    // Wrap the row, then rotate the sprite into place so it wraps at the right edge.
+    // Clipped sprites stop at the bottom and shift into place instead.
+    int row = y + yline;
+    if ((quirks & CHIP8_QUIRK_CLIP) && row >= chip8->ScreenHeight)
     {
-
-    // EX9E - SKP Vx
-    case 0x009E:
-      // Skip next instruction if key with the value of Vx is pressed.
-      if (Chip8_KeyStates[Chip8_VRegister[x]] == CHIP8_KEYDOWN)
-      {
-        Chip8_ProgramCounter += 2;
-      }
-      Chip8_ProgramCounter += 2;
       break;
+    }
+    row %= chip8->ScreenHeight;
+    Chip8_MarkDirty(chip8, (uint64_t)1 << row);
 
-    // EXA1 - SKNP Vx
-    case 0x00A1:
-      // Skip next instruction if key with the value of Vx is not pressed.
-      if (Chip8_KeyStates[Chip8_VRegister[x]] == CHIP8_KEYUP)
+    if (chip8->ScreenWidth == 64)
+    {
+      uint64_t *Line = &chip8->DisplayMemory[row];
+      uint64_t Pixels = (quirks & CHIP8_QUIRK_CLIP) ? Sprite >> col : Chip8_RotateRight(Sprite, col);
+
+      // XOR and set flags as needed.
+      if (*Line & Pixels)
       {
-        Chip8_ProgramCounter += 2;
+        chip8->VRegister[0xF] = 1;
       }
-      Chip8_ProgramCounter += 2;
-      break;
-
-    default:
-      break;
+      *Line ^= Pixels;
     }
-    break;
-
-  case 0xF000:
-    switch (Chip8_OpCode & 0x00FF)
+    else
     {
-    // FX07 - LD Vx, Chip8_DelayTimer
-    case 0x0007:
-      // Set Vx = Chip8_DelayTimer value.
-      Chip8_VRegister[x] = Chip8_DelayTimer;
-      Chip8_ProgramCounter += 2;
-      break;
+      // A high res row is two words, rotate across both of them.
+      uint64_t *Line = &chip8->DisplayMemory[row * 2];
+      uint64_t Left = Sprite;
+      uint64_t Right = 0;
+      int shift = col;
 
-    // FX0A - LD Vx, K
-    case 0x000A:
-      // Wait for a key press, store the value of the key in Vx. All execution stops until a key is pressed,
-      for (int i = 0; i < 16; i++)
+      if (shift >= 64)
       {
-        if (Chip8_KeyStates[i] == CHIP8_KEYDOWN)
-        {
-          Chip8_VRegister[x] = i;
-          keyPress = 1;
-        }
+        Right = Left;
+        Left = 0;
+        shift -= 64;
       }
-      // If we didn't received a keypress, skip this cycle and try again.
-      if (!keyPress)
+      if (shift != 0)
       {
-        return;
+        uint64_t Carry = Left << (64 - shift);
+        Left = (Left >> shift) | ((quirks & CHIP8_QUIRK_CLIP) ? 0 : Right << (64 - shift));
+        Right = (Right >> shift) | Carry;
       }
-      Chip8_ProgramCounter += 2;
-      break;
-
-    // FX15 - LD Chip8_DelayTimer, Vx
-    case 0x0015:
-      // Set Chip8_DelayTimer = Vx.
-      Chip8_DelayTimer = Chip8_VRegister[x];
-      Chip8_ProgramCounter += 2;
-      break;
-
-    // FX18 - LD Chip8_SoundTimer, Vx
-    case 0x0018:
-      // Set sound timer = Vx.
-      Chip8_SoundTimer = Chip8_VRegister[x];
-      Chip8_ProgramCounter += 2;
-      break;
 
-    // FX1E - ADD I, Vx
-    case 0x001E:
-      // VF is set to 1 when range overflow occurs (Chip8_IndexRegister + VX > 0xFFF), and 0 when it isn't.
-      Chip8_VRegister[0xF] = 0;
-      if (Chip8_IndexRegister + Chip8_VRegister[x] >= 0xFFF)
+      // XOR and set flags as needed.
+      if ((Line[0] & Left) | (Line[1] & Right))
       {
-        Chip8_VRegister[0xF] = 1;
+        chip8->VRegister[0xF] = 1;
       }
-      Chip8_IndexRegister += Chip8_VRegister[x];
-      Chip8_ProgramCounter += 2;
-      break;
+      Line[0] ^= Left;
+      Line[1] ^= Right;
+    }
+  }
+  chip8->ProgramCounter += 2;
 
-    // FX29 - LD F, Vx
-    case 0x0029:
-      // Set Chip8_IndexRegister = location of sprite for digit Vx.
-      Chip8_IndexRegister = Chip8_VRegister[x] * 0x5;
-      Chip8_ProgramCounter += 2;
+  // The VIP drew in time with the display, so halt until the next frame.
+  if (quirks & CHIP8_QUIRK_DISPLAYWAIT)
+  {
+    chip8->RunState = CHIP8_WAITING_FOR_VBLANK;
+    chip8->StopReason = CHIP8_EXIT_VBLANK;
+  }
+}
+
+// DXYN - Sprites wrap.
+static void Chip8_OpDXYN(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  Chip8_DrawSprite(chip8, ins, 0);
+}
+
+// DXYN with CHIP8_QUIRK_CLIP.
+static void Chip8_OpDXYNClip(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  Chip8_DrawSprite(chip8, ins, CHIP8_QUIRK_CLIP);
+}
+
+// DXYN with CHIP8_QUIRK_DISPLAYWAIT.
+static void Chip8_OpDXYNWait(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  Chip8_DrawSprite(chip8, ins, CHIP8_QUIRK_DISPLAYWAIT);
+}
+
+// DXYN with CHIP8_QUIRK_CLIP and CHIP8_QUIRK_DISPLAYWAIT.
+static void Chip8_OpDXYNClipWait(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  Chip8_DrawSprite(chip8, ins, CHIP8_QUIRK_CLIP | CHIP8_QUIRK_DISPLAYWAIT);
+}
+
+// EX9E - SKP Vx
+static void Chip8_OpEX9E(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Skip next instruction if key with the value of Vx is pressed.
+  if (chip8->KeyStates[chip8->VRegister[ins->x]] == CHIP8_KEYDOWN)
+  {
+    chip8->ProgramCounter += 2;
+  }
+  chip8->ProgramCounter += 2;
+}
+
+// EXA1 - SKNP Vx
+static void Chip8_OpEXA1(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Skip next instruction if key with the value of Vx is not pressed.
+  if (chip8->KeyStates[chip8->VRegister[ins->x]] == CHIP8_KEYUP)
+  {
+    chip8->ProgramCounter += 2;
+  }
+  chip8->ProgramCounter += 2;
+}
+
+// FX07 - LD Vx, DelayTimer
+static void Chip8_OpFX07(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Set Vx = DelayTimer value.
+  chip8->VRegister[ins->x] = chip8->DelayTimer;
+  chip8->ProgramCounter += 2;
+}
+
+// FX0A - LD Vx, K
+static void Chip8_OpFX0A(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  int keyPress = 0;
+
+  // Wait for a key press, store the value of the key in Vx. All execution stops until a key is pressed,
+  for (int i = 0; i < 16; i++)
+  {
+    if (chip8->KeyStates[i] == CHIP8_KEYDOWN)
+    {
+      chip8->VRegister[ins->x] = i;
+      keyPress = 1;
+    }
+  }
+
+  // If we didn't received a keypress, leave the program counter alone and halt until
+  // Chip8_GetKeyStates sees a key, the OpCode then runs again to pick it up.
+  if (keyPress)
+  {
+    chip8->ProgramCounter += 2;
+    chip8->RunState = CHIP8_RUNNING;
+  }
+  else
+  {
+    chip8->RunState = CHIP8_WAITING_FOR_KEY;
+    chip8->StopReason = CHIP8_EXIT_KEYWAIT;
+  }
+}
+
+// FX15 - LD DelayTimer, Vx
+static void Chip8_OpFX15(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Set DelayTimer = Vx.
+  chip8->DelayTimer = chip8->VRegister[ins->x];
+  chip8->ProgramCounter += 2;
+}
+
+// FX18 - LD SoundTimer, Vx
+static void Chip8_OpFX18(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Set sound timer = Vx.
+  chip8->SoundTimer = chip8->VRegister[ins->x];
+  chip8->ProgramCounter += 2;
+}
+
+// FX1E - ADD I, Vx
+static void Chip8_OpFX1E(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // VF is set to 1 when range overflow occurs (IndexRegister + VX > 0xFFF), and 0 when it isn't.
+  chip8->VRegister[0xF] = 0;
+  if (chip8->IndexRegister + chip8->VRegister[ins->x] >= 0xFFF)
+  {
+    chip8->VRegister[0xF] = 1;
+  }
+  chip8->IndexRegister += chip8->VRegister[ins->x];
+  chip8->ProgramCounter += 2;
+}
+
+// FX29 - LD F, Vx
+static void Chip8_OpFX29(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Set IndexRegister = location of sprite for digit Vx.
+  chip8->IndexRegister = chip8->VRegister[ins->x] * 0x5;
+  chip8->ProgramCounter += 2;
+}
+
+// FX30 - SET I,V[X]
+static void Chip8_OpFX30(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Point I to 10-byte font sprite for digit VX (only digits 0-9)
+  chip8->IndexRegister = 80 + (chip8->VRegister[ins->x] * 10);
+  chip8->ProgramCounter += 2;
+}
+
+// FX33 - LD B, Vx
+static void Chip8_OpFX33(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // store BCD representation of Vx in memory locations IndexRegister, IndexRegister+1, and IndexRegister+2.
+  // The interpreter takes the decimal value of Vx, and places the hundreds digit in memory at location in IndexRegister,
+  // the tens digit at location I + 1, and the ones digit at location IndexRegister + 2.
+  // I can run past the end of memory, guest addresses wrap at 4K like the decode cache.
+  chip8->ProgramMemory[chip8->IndexRegister & 0xFFF] = chip8->VRegister[ins->x] / 100;
+  chip8->ProgramMemory[(chip8->IndexRegister + 1) & 0xFFF] = (chip8->VRegister[ins->x] / 10) % 10;
+  chip8->ProgramMemory[(chip8->IndexRegister + 2) & 0xFFF] = (chip8->VRegister[ins->x] % 100) % 10;
+  Chip8_InvalidateDecodeCache(chip8, chip8->IndexRegister, 3);
+  chip8->ProgramCounter += 2;
+}
+
+// FX55 - LD [IndexRegister], Vx
+static void Chip8_OpFX55(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // The interpreter copies the values of registers V0 through Vx into memory, starting at the address in IndexRegister.
+  for (int i = 0; i <= ins->x; i++)
+  {
+    chip8->ProgramMemory[(chip8->IndexRegister + i) & 0xFFF] = chip8->VRegister[i];
+  }
+  Chip8_InvalidateDecodeCache(chip8, chip8->IndexRegister, ins->x + 1);
+  chip8->ProgramCounter += 2;
+}
+
+// FX55 with CHIP8_QUIRK_LOADSTORE, I is left just past the last register stored.
+static void Chip8_OpFX55Past(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  Chip8_OpFX55(chip8, ins);
+  chip8->IndexRegister += ins->x + 1;
+}
+
+// FX55 with CHIP8_QUIRK_LOADSTOREX, I is left on the last register stored.
+static void Chip8_OpFX55Last(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  Chip8_OpFX55(chip8, ins);
+  chip8->IndexRegister += ins->x;
+}
+
+// FX65 - LD Vx, [I]
+static void Chip8_OpFX65(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Read registers V0 through Vx from memory starting at location I.
+  for (int i = 0; i <= ins->x; i++)
+  {
+    chip8->VRegister[i] = chip8->ProgramMemory[(chip8->IndexRegister + i) & 0xFFF];
+  }
+  chip8->ProgramCounter += 2;
+}
+
+// FX65 with CHIP8_QUIRK_LOADSTORE, I is left just past the last register read.
+static void Chip8_OpFX65Past(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  Chip8_OpFX65(chip8, ins);
+  chip8->IndexRegister += ins->x + 1;
+}
+
+// FX65 with CHIP8_QUIRK_LOADSTOREX, I is left on the last register read.
+static void Chip8_OpFX65Last(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  Chip8_OpFX65(chip8, ins);
+  chip8->IndexRegister += ins->x;
+}
+
+// FX75 - Store V0..VX in the HP48 registers.
+static void Chip8_OpFX75(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Store the CHIP8 Registers V[0]-V[x] in the HP48 registers.
+  for (int c = 0; c <= ins->x; c++)
+  {
+    chip8->HP48Registers[c] = chip8->VRegister[c];
+  }
+  chip8->ProgramCounter += 2;
+}
+
+// FX85 - Read V0..VX from the HP48 registers.
+static void Chip8_OpFX85(Chip8_Machine *chip8, const Chip8_Instruction *ins)
+{
+  // Read from HP48 Registers a fill the CHIP8 Registers V[0]-V[x].
+  for (int c = 0; c <= ins->x; c++)
+  {
+    chip8->VRegister[c] = chip8->HP48Registers[c];
+  }
+  chip8->ProgramCounter += 2;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_CheckedStop
+ * Runs an instruction that can stop the run, FX0A, 00FD or an unknown OpCode.
+ * It sits in the Fused slot of the decode cache, so the decoded core's loop
+ * learns of a stop from the count returned and checks nothing for the rest.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to run.
+ * const Chip8_Instruction *ins - The instruction.
+ * int cycles - The cycles left in the run, at least one.
+ *
+ * Returns:
+ * int - The cycles used, negated if the instruction stopped the run.
+ */
+static int Chip8_CheckedStop(Chip8_Machine *chip8, const Chip8_Instruction *ins, int cycles)
+{
+  ins->Handler(chip8, ins);
+  return chip8->StopReason ? -(int)ins->Cost : ins->Cost;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_SplitOpCode
+ * Extracts the operands of an OpCode and picks the handler that executes it,
+ * the one built for the quirks given where they change what it does.
+ *
+ * Parameters:
+ * Chip8_Instruction *ins - Receives the decoded instruction.
+ * unsigned short OpCode - The OpCode to decode.
+ * int quirks - CHIP8_QUIRK flags of the profile to decode for.
+ *
+ * Returns:
+ * void.
+ */
+static void Chip8_SplitOpCode(Chip8_Instruction *ins, unsigned short OpCode, int quirks)
+{
+  Chip8_OpHandler Handler = Chip8_OpUnknown;
+
+  // Extract the most common values from the OpCode
+  ins->OpCode = OpCode;
+  ins->Lead = 0;
+  ins->Fused = NULL;
+  ins->x = (OpCode & 0x0F00) >> 8;
+  ins->y = (OpCode & 0x00F0) >> 4;
+  ins->n = (OpCode & 0x000F);
+  ins->kk = (OpCode & 0x00FF);
+  ins->nnn = (OpCode & 0x0FFF);
+
+  // Pick the handler for the OpCode.
+  switch (OpCode & 0xF000)
+  {
+  case 0x0000:
+    if ((OpCode & 0x00F0) == 0x00C0)
+    {
+      Handler = Chip8_Op00CN;
       break;
+    }
+
+    switch (OpCode & 0x00FF)
+    {
+    case 0x00E0: Handler = Chip8_Op00E0; break;
+    case 0x00EE: Handler = Chip8_Op00EE; break;
+    case 0x00FB: Handler = Chip8_Op00FB; break;
+    case 0x00FC: Handler = Chip8_Op00FC; break;
+    case 0x00FD: Handler = Chip8_Op00FD; break;
+    case 0x00FE: Handler = Chip8_Op00FE; break;
+    case 0x00FF: Handler = Chip8_Op00FF; break;
+    default: break;
+    }
+    break;
+
+  case 0x1000: Handler = Chip8_Op1NNN; break;
+  case 0x2000: Handler = Chip8_Op2NNN; break;
+  case 0x3000: Handler = Chip8_Op3XKK; break;
+  case 0x4000: Handler = Chip8_Op4XKK; break;
+  case 0x5000: Handler = Chip8_Op5XY0; break;
+  case 0x6000: Handler = Chip8_Op6XKK; break;
+  case 0x7000: Handler = Chip8_Op7XKK; break;
+
+  case 0x8000:
+    switch (OpCode & 0x000F)
+    {
+    case 0x0000: Handler = Chip8_Op8XY0; break;
+    case 0x0001: Handler = Chip8_Op8XY1; break;
+    case 0x0002: Handler = Chip8_Op8XY2; break;
+    case 0x0003: Handler = Chip8_Op8XY3; break;
+    case 0x0004: Handler = Chip8_Op8XY4; break;
+    case 0x0005: Handler = Chip8_Op8XY5; break;
+    case 0x0006: Handler = (quirks & CHIP8_QUIRK_SHIFTVY) ? Chip8_Op8XY6Vy : Chip8_Op8XY6; break;
+    case 0x0007: Handler = Chip8_Op8XY7; break;
+    case 0x000E: Handler = (quirks & CHIP8_QUIRK_SHIFTVY) ? Chip8_Op8XYEVy : Chip8_Op8XYE; break;
+    default: break;
+    }
+    break;
+
+  case 0x9000: Handler = Chip8_Op9XY0; break;
+  case 0xA000: Handler = Chip8_OpANNN; break;
+  case 0xB000: Handler = (quirks & CHIP8_QUIRK_JUMPVX) ? Chip8_OpBXNN : Chip8_OpBNNN; break;
+  case 0xC000: Handler = Chip8_OpCXKK; break;
+  case 0xD000:
+    switch (quirks & (CHIP8_QUIRK_CLIP | CHIP8_QUIRK_DISPLAYWAIT))
+    {
+    case CHIP8_QUIRK_CLIP: Handler = Chip8_OpDXYNClip; break;
+    case CHIP8_QUIRK_DISPLAYWAIT: Handler = Chip8_OpDXYNWait; break;
+    case CHIP8_QUIRK_CLIP | CHIP8_QUIRK_DISPLAYWAIT: Handler = Chip8_OpDXYNClipWait; break;
+    default: Handler = Chip8_OpDXYN; break;
+    }
+    break;
+
+  case 0xE000:
+    switch (OpCode & 0x00FF)
+    {
+    case 0x009E: Handler = Chip8_OpEX9E; break;
+    case 0x00A1: Handler = Chip8_OpEXA1; break;
+    default: break;
+    }
+    break;
+
+  case 0xF000:
+    switch (OpCode & 0x00FF)
+    {
+    case 0x0007: Handler = Chip8_OpFX07; break;
+    case 0x000A: Handler = Chip8_OpFX0A; break;
+    case 0x0015: Handler = Chip8_OpFX15; break;
+    case 0x0018: Handler = Chip8_OpFX18; break;
+    case 0x001E: Handler = Chip8_OpFX1E; break;
+    case 0x0029: Handler = Chip8_OpFX29; break;
+    case 0x0030: Handler = Chip8_OpFX30; break;
+    case 0x0033: Handler = Chip8_OpFX33; break;
+    case 0x0055:
+      Handler = (quirks & CHIP8_QUIRK_LOADSTORE) ? Chip8_OpFX55Past : (quirks & CHIP8_QUIRK_LOADSTOREX) ? Chip8_OpFX55Last : Chip8_OpFX55;
+      break;
+    case 0x0065:
+      Handler = (quirks & CHIP8_QUIRK_LOADSTORE) ? Chip8_OpFX65Past : (quirks & CHIP8_QUIRK_LOADSTOREX) ? Chip8_OpFX65Last : Chip8_OpFX65;
+      break;
+    case 0x0075: Handler = Chip8_OpFX75; break;
+    case 0x0085: Handler = Chip8_OpFX85; break;
+    default: break;
+    }
+    break;
+  }
+
+  ins->Handler = Handler;
+
+  // Only these can stop a run, so the decoded core only looks for a stop after them.
+  if (Handler == Chip8_OpUnknown || Handler == Chip8_Op00FD || Handler == Chip8_OpFX0A ||
+      Handler == Chip8_OpDXYNWait || Handler == Chip8_OpDXYNClipWait)
+  {
+    ins->Fused = Chip8_CheckedStop;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+// Superinstructions. Each one runs the handlers of its sequence back to back
+// using the decode cache entries that follow it, so the machine ends up in
+// exactly the state the separate instructions would leave it in.
+
+// 6XKK 6YKK DXYN - Load coordinates and draw.
+static int Chip8_FusedDrawAt(Chip8_Machine *chip8, const Chip8_Instruction *ins, int cycles)
+{
+  Chip8_Op6XKK(chip8, &ins[0]);
+  Chip8_Op6XKK(chip8, &ins[2]);
+  ins[4].Handler(chip8, &ins[4]);
+  chip8->OpCode = ins[4].OpCode;
+  chip8->FusedInstructions[CHIP8_FUSE_DRAWAT] += 3;
+  return ins[0].Cost + ins[2].Cost + ins[4].Cost;
+}
+
+// ANNN DXYN - Point I at a sprite and draw.
+static int Chip8_FusedDrawSprite(Chip8_Machine *chip8, const Chip8_Instruction *ins, int cycles)
+{
+  Chip8_OpANNN(chip8, &ins[0]);
+  ins[2].Handler(chip8, &ins[2]);
+  chip8->OpCode = ins[2].OpCode;
+  chip8->FusedInstructions[CHIP8_FUSE_DRAWSPRITE] += 2;
+  return ins[0].Cost + ins[2].Cost;
+}
+
+// 3XKK 1NNN at the end of a loop, the jump is skipped once Vx reaches kk.
+static inline int Chip8_FusedLoopTest(Chip8_Machine *chip8, const Chip8_Instruction *ins, int fusion)
+{
+  unsigned short next = chip8->ProgramCounter + 2;
+
+  Chip8_Op3XKK(chip8, &ins[2]);
+  if (chip8->ProgramCounter != next)
+  {
+    chip8->OpCode = ins[2].OpCode;
+    chip8->FusedInstructions[fusion] += 2;
+    return ins[0].Cost + ins[2].Cost;
+  }
+
+  Chip8_Op1NNN(chip8, &ins[4]);
+  chip8->OpCode = ins[4].OpCode;
+  chip8->FusedInstructions[fusion] += 3;
+  return ins[0].Cost + ins[2].Cost + ins[4].Cost;
+}
+
+// 7XKK 3XKK 1NNN - Counter loop.
+static int Chip8_FusedCountLoop(Chip8_Machine *chip8, const Chip8_Instruction *ins, int cycles)
+{
+  Chip8_Op7XKK(chip8, &ins[0]);
+  return Chip8_FusedLoopTest(chip8, ins, CHIP8_FUSE_COUNTLOOP);
+}
+
+// A loop that has just gone round once, back to address, and whose next
+// iterations depend only on the timers and keys. Those only change between
+// calls to Chip8_EmulateCycles, so every remaining iteration would leave the
+// machine exactly as it is now and the whole iterations that fit in the
+// cycles left are skipped. An iteration takes loop cycles and length
+// instructions.
+static inline int Chip8_IdleLoop(Chip8_Machine *chip8, unsigned short address, int executed, int loop, int length, int cycles, int fusion)
+{
+  if (chip8->ProgramCounter != address || executed >= cycles)
+  {
+    return executed;
+  }
+
+  int iterations = (cycles - executed) / loop;
+  chip8->FusedInstructions[fusion] += iterations * length;
+  chip8->IdleInstructions += iterations * length;
+  chip8->Idle = 1;
+  return executed + iterations * loop;
+}
+
+// FX07 3X00 1NNN - Wait for the delay timer.
+static int Chip8_FusedDelayWait(Chip8_Machine *chip8, const Chip8_Instruction *ins, int cycles)
+{
+  unsigned short address = chip8->ProgramCounter;
+
+  Chip8_OpFX07(chip8, &ins[0]);
+  int executed = Chip8_FusedLoopTest(chip8, ins, CHIP8_FUSE_DELAYWAIT);
+  return Chip8_IdleLoop(chip8, address, executed, executed, 3, cycles, CHIP8_FUSE_DELAYWAIT);
+}
+
+// EX9E / EXA1 1NNN - Wait for a key, jumping back to the test.
+static int Chip8_FusedKeyWait(Chip8_Machine *chip8, const Chip8_Instruction *ins, int cycles)
+{
+  unsigned short address = chip8->ProgramCounter;
+
+  ins[0].Handler(chip8, &ins[0]);
+  if (chip8->ProgramCounter != address + 2)
+  {
+    chip8->FusedInstructions[CHIP8_FUSE_KEYWAIT] += 1;
+    return ins[0].Cost;
+  }
+
+  Chip8_Op1NNN(chip8, &ins[2]);
+  chip8->OpCode = ins[2].OpCode;
+  chip8->FusedInstructions[CHIP8_FUSE_KEYWAIT] += 2;
+  int loop = ins[0].Cost + ins[2].Cost;
+  return Chip8_IdleLoop(chip8, address, loop, loop, 2, cycles, CHIP8_FUSE_KEYWAIT);
+}
+
+// 1NNN - Jump to itself.
+static int Chip8_FusedSelfJump(Chip8_Machine *chip8, const Chip8_Instruction *ins, int cycles)
+{
+  Chip8_Op1NNN(chip8, &ins[0]);
+  chip8->FusedInstructions[CHIP8_FUSE_SELFJUMP] += 1;
+  return Chip8_IdleLoop(chip8, ins->nnn, ins->Cost, ins->Cost, 1, cycles, CHIP8_FUSE_SELFJUMP);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_FuseInstructions
+ * Checks whether a freshly decoded instruction starts a sequence that can run
+ * as a superinstruction, and if so decodes the rest of the sequence and
+ * attaches the fused handler to the first entry.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to decode for.
+ * Chip8_Instruction *ins - The decode cache entry for the first instruction.
+ * unsigned short address - Address of the first instruction.
+ *
+ * Returns:
+ * void.
+ */
+static void Chip8_FuseInstructions(Chip8_Machine *chip8, Chip8_Instruction *ins, unsigned short address)
+{
+  Chip8_FusedHandler Fused = NULL;
+  int fusion = 0;
+  int length = 0;
+
+  // The fused handlers index the following cache entries directly, so the sequence can't wrap.
+  if (address + 2 * CHIP8_FUSE_MAXLENGTH > 4096)
+  {
+    return;
+  }
+
+  unsigned short second = (chip8->ProgramMemory[address + 2] << 8) + chip8->ProgramMemory[address + 3];
+  unsigned short third = (chip8->ProgramMemory[address + 4] << 8) + chip8->ProgramMemory[address + 5];
+
+  // A sprite that waits for the frame stops the run, which only Chip8_CheckedStop reports.
+  int draws = !(chip8->Quirks & CHIP8_QUIRK_DISPLAYWAIT);
+
+  switch (ins->OpCode & 0xF000)
+  {
+  case 0x6000:
+    if (draws && (second & 0xF000) == 0x6000 && (third & 0xF000) == 0xD000)
+    {
+      Fused = Chip8_FusedDrawAt;
+      fusion = CHIP8_FUSE_DRAWAT;
+      length = 3;
+    }
+    break;
+
+  case 0xA000:
+    if (draws && (second & 0xF000) == 0xD000)
+    {
+      Fused = Chip8_FusedDrawSprite;
+      fusion = CHIP8_FUSE_DRAWSPRITE;
+      length = 2;
+    }
+    break;
+
+  case 0x7000:
+    if ((second & 0xFF00) == (0x3000 | (ins->x << 8)) && (third & 0xF000) == 0x1000)
+    {
+      Fused = Chip8_FusedCountLoop;
+      fusion = CHIP8_FUSE_COUNTLOOP;
+      length = 3;
+    }
+    break;
+
+  case 0xF000:
+    if (ins->kk == 0x07 && second == (0x3000 | (ins->x << 8)) && (third & 0xF000) == 0x1000)
+    {
+      Fused = Chip8_FusedDelayWait;
+      fusion = CHIP8_FUSE_DELAYWAIT;
+      length = 3;
+    }
+    break;
+
+  case 0xE000:
+    if ((ins->kk == 0x9E || ins->kk == 0xA1) && second == (0x1000 | address))
+    {
+      Fused = Chip8_FusedKeyWait;
+      fusion = CHIP8_FUSE_KEYWAIT;
+      length = 2;
+    }
+    break;
+
+  case 0x1000:
+    if (ins->nnn == address)
+    {
+      Fused = Chip8_FusedSelfJump;
+      fusion = CHIP8_FUSE_SELFJUMP;
+      length = 1;
+    }
+    break;
+  }
+
+  if (Fused == NULL)
+  {
+    return;
+  }
+
+  // Make sure the rest of the sequence is in the cache, and add up the cycles taken before its last instruction.
+  int lead = 0;
+  for (int i = 1; i < length; i++)
+  {
+    if (ins[i * 2].Handler == NULL)
+    {
+      Chip8_SplitOpCode(&ins[i * 2], (chip8->ProgramMemory[address + i * 2] << 8) + chip8->ProgramMemory[address + i * 2 + 1], chip8->Quirks);
+      ins[i * 2].Cost = chip8->CycleCosts[ins[i * 2].OpCode];
+    }
+    lead += ins[(i - 1) * 2].Cost;
+  }
+
+  ins->Fused = Fused;
+  ins->Lead = (unsigned short)lead;
+  chip8->FusedSites[fusion]++;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_DecodeInstruction
+ * Decodes the OpCode at the given address and stores the result in the decode cache,
+ * fusing it with the instructions that follow where it starts a superinstruction.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to decode for.
+ * unsigned short address - Address of the OpCode in program memory.
+ *
+ * Returns:
+ * Chip8_Instruction * - The decode cache entry for the address.
+ */
+static Chip8_Instruction *Chip8_DecodeInstruction(Chip8_Machine *chip8, unsigned short address)
+{
+  Chip8_Instruction *ins = &chip8->DecodeCache[address & 0xFFF];
+
+  Chip8_SplitOpCode(ins, (chip8->ProgramMemory[address & 0xFFF] << 8) + chip8->ProgramMemory[(address + 1) & 0xFFF], chip8->Quirks);
+  ins->Cost = chip8->CycleCosts[ins->OpCode];
+  Chip8_FuseInstructions(chip8, ins, address & 0xFFF);
+  return ins;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_KeyPressed
+ * Checks whether any Chip8 key is down.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to check.
+ *
+ * Returns:
+ * int - 1 if a key is down, otherwise 0.
+ */
+static int Chip8_KeyPressed(Chip8_Machine *chip8)
+{
+  for (int i = 0; i < 16; i++)
+  {
+    if (chip8->KeyStates[i] == CHIP8_KEYDOWN)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
 
-    // FX30 - SET I,V[X]
-    case 0x0030:
-      // Point I to 10-byte font sprite for digit VX (only digits 0-9)
-      Chip8_IndexRegister = 80 + (Chip8_VRegister[x] * 10);
-      Chip8_ProgramCounter += 2;
-      break;
+//------------------------------------------------------------------------------
 
-    // FX33 - LD B, Vx
-    case 0x0033:
-      // store BCD representation of Vx in memory locations Chip8_IndexRegister, Chip8_IndexRegister+1, and Chip8_IndexRegister+2.
-      // The interpreter takes the decimal value of Vx, and places the hundreds digit in memory at location in Chip8_IndexRegister,
-      // the tens digit at location I + 1, and the ones digit at location Chip8_IndexRegister + 2.
-      Chip8_ProgramMemory[Chip8_IndexRegister] = Chip8_VRegister[x] / 100;
-      Chip8_ProgramMemory[Chip8_IndexRegister + 1] = (Chip8_VRegister[x] / 10) % 10;
-      Chip8_ProgramMemory[Chip8_IndexRegister + 2] = (Chip8_VRegister[x] % 100) % 10;
-      Chip8_ProgramCounter += 2;
-      break;
+/*
+ * Function: Chip8_QueueEvent
+ * Adds an event to the scheduler, after any others due at the same cycle so
+ * events happen in the order they were queued.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to schedule for.
+ * uint64_t cycle - The cycle the event happens at.
+ * int type - One of CHIP8_EVENTS.
+ * unsigned short keys - Keypad state for CHIP8_EVENT_KEYS.
+ *
+ * Returns:
+ * int - 1 if the event was queued, 0 if the queue is full.
+ */
+static int Chip8_QueueEvent(Chip8_Machine *chip8, uint64_t cycle, int type, unsigned short keys)
+{
+  if (chip8->EventCount == CHIP8_MAX_EVENTS)
+  {
+    return 0;
+  }
 
-    // FX55 - LD [Chip8_IndexRegister], Vx
-    case 0x0055:
-      // The interpreter copies the values of registers V0 through Vx into memory, starting at the address in Chip8_IndexRegister.
-      for (int i = 0; i <= x; i++)
+  int i = chip8->EventCount++;
+  while (i > 0 && chip8->Events[i - 1].Cycle > cycle)
+  {
+    chip8->Events[i] = chip8->Events[i - 1];
+    i--;
+  }
+  chip8->Events[i].Cycle = cycle;
+  chip8->Events[i].Type = type;
+  chip8->Events[i].Keys = keys;
+  return 1;
+}
+
+// The cycle the nth 60Hz event after TickBase happens at, exact for any speed.
+static inline uint64_t Chip8_TickCycle(Chip8_Machine *chip8, uint64_t n)
+{
+  return chip8->TickBase + (n * (uint64_t)chip8->CyclesPerSecond) / 60;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_RunEvents
+ * Runs every event due by the machine's current cycle, in order. The 60Hz
+ * events queue their next occurrence as they run.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to run the events for.
+ *
+ * Returns:
+ * void.
+ */
+static void Chip8_RunEvents(Chip8_Machine *chip8)
+{
+  while (chip8->EventCount > 0 && chip8->Events[0].Cycle <= chip8->Cycles)
+  {
+    Chip8_Event Event = chip8->Events[0];
+    chip8->EventCount--;
+    memmove(&chip8->Events[0], &chip8->Events[1], chip8->EventCount * sizeof(Chip8_Event));
+
+    switch (Event.Type)
+    {
+    case CHIP8_EVENT_TIMERS:
+      if (chip8->DelayTimer > 0)
+      {
+        chip8->DelayTimer--;
+      }
+
+      // No sound implemented at the moment, enjoy the silence!
+      if (chip8->SoundTimer > 0)
       {
-        Chip8_ProgramMemory[Chip8_IndexRegister + i] = Chip8_VRegister[i];
+        chip8->SoundTimer--;
       }
-      Chip8_ProgramCounter += 2;
+      Chip8_QueueEvent(chip8, Chip8_TickCycle(chip8, ++chip8->TimerTicks + 1), CHIP8_EVENT_TIMERS, 0);
       break;
 
-    // FX65 - LD Vx, [I]
-    case 0x0065:
-      // Read registers V0 through Vx from memory starting at location I.
-      for (int i = 0; i <= x; i++)
+    case CHIP8_EVENT_VBLANK:
+      chip8->VBlank = 1;
+      chip8->Cycles += chip8->TimingModel->VBlank;
+      if (chip8->RunState == CHIP8_WAITING_FOR_VBLANK)
       {
-        Chip8_VRegister[i] = Chip8_ProgramMemory[Chip8_IndexRegister + i];
+        chip8->RunState = CHIP8_RUNNING;
       }
-      Chip8_ProgramCounter += 2;
+      Chip8_QueueEvent(chip8, Chip8_TickCycle(chip8, ++chip8->Frames + 1), CHIP8_EVENT_VBLANK, 0);
       break;
 
-    case 0x0075:
-      // Store the CHIP8 Registers V[0]-V[x] in the HP48 registers.
-      for (int c = 0; c <= x; c++)
-      {
-        Chip8_HP48Registers[c] = Chip8_VRegister[c];
-      }
-      Chip8_ProgramCounter += 2;
-      break;
+    case CHIP8_EVENT_KEYS:
+      Chip8_SetKeyStates(chip8, Event.Keys);
+      break;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_SetSpeed
+ * Sets how many cycles the machine runs each second, which spaces out the
+ * 60Hz timer and vblank events. They are counted again from the current
+ * cycle, keys already scheduled still arrive when they were due.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to pace.
+ * int cyclesPerSecond - The speed, at least 1.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_SetSpeed(Chip8_Machine *chip8, int cyclesPerSecond)
+{
+  chip8->CyclesPerSecond = (cyclesPerSecond > 0) ? cyclesPerSecond : CHIP8_DEFAULT_SPEED;
+  chip8->TickBase = chip8->Cycles;
+  chip8->TimerTicks = 0;
+  chip8->Frames = 0;
+
+  // Drop the 60Hz events, keeping the keys.
+  int Kept = 0;
+  for (int i = 0; i < chip8->EventCount; i++)
+  {
+    if (chip8->Events[i].Type == CHIP8_EVENT_KEYS)
+    {
+      chip8->Events[Kept++] = chip8->Events[i];
+    }
+  }
+  chip8->EventCount = Kept;
+
+  Chip8_QueueEvent(chip8, Chip8_TickCycle(chip8, 1), CHIP8_EVENT_TIMERS, 0);
+  Chip8_QueueEvent(chip8, Chip8_TickCycle(chip8, 1), CHIP8_EVENT_VBLANK, 0);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_OpCodeCycles
+ * Works out the cycles an OpCode takes under a timing model, apart from the
+ * rows DXYN draws, which depend on the mode and are charged as it draws.
+ *
+ * Parameters:
+ * const Chip8_TimingModel *model - The timing model.
+ * unsigned short OpCode - The OpCode.
+ *
+ * Returns:
+ * unsigned short - The cycles it takes.
+ */
+static unsigned short Chip8_OpCodeCycles(const Chip8_TimingModel *model, unsigned short OpCode)
+{
+  int x = (OpCode & 0x0F00) >> 8;
+  int Cycles = 0;
+
+  switch (OpCode & 0xF000)
+  {
+  case 0x0000:
+    if ((OpCode & 0x00F0) == 0x00C0 || OpCode == 0x00E0 || OpCode == 0x00FB || OpCode == 0x00FC)
+    {
+      Cycles = model->Screen;
+    }
+    else if (OpCode == 0x00EE)
+    {
+      Cycles = model->Return;
+    }
+    else
+    {
+      Cycles = model->Mode;
+    }
+    break;
+  case 0x1000: Cycles = model->Jump; break;
+  case 0x2000: Cycles = model->Call; break;
+  case 0x3000: Cycles = model->SkipByte; break;
+  case 0x4000: Cycles = model->SkipByte; break;
+  case 0x5000: Cycles = model->SkipReg; break;
+  case 0x6000: Cycles = model->Load; break;
+  case 0x7000: Cycles = model->Add; break;
+  case 0x8000:
+    switch (OpCode & 0x000F)
+    {
+    case 0x0000: Cycles = model->Move; break;
+    case 0x0001:
+    case 0x0002:
+    case 0x0003: Cycles = model->Logic; break;
+    default: Cycles = model->Arith; break;
+    }
+    break;
+  case 0x9000: Cycles = model->SkipReg; break;
+  case 0xA000: Cycles = model->Index; break;
+  case 0xB000: Cycles = model->JumpOffset; break;
+  case 0xC000: Cycles = model->Random; break;
+  case 0xD000: Cycles = model->Draw; break;
+  case 0xE000: Cycles = model->KeySkip; break;
+  case 0xF000:
+    switch (OpCode & 0x00FF)
+    {
+    case 0x000A: Cycles = model->KeyWait; break;
+    case 0x001E: Cycles = model->AddIndex; break;
+    case 0x0029:
+    case 0x0030: Cycles = model->Font; break;
+    case 0x0033: Cycles = model->Decimal; break;
+    case 0x0055:
+    case 0x0065:
+    case 0x0075:
+    case 0x0085: Cycles = model->Memory + (x + 1) * model->Register; break;
+    default: Cycles = model->Timer; break;
+    }
+    break;
+  }
+
+  return (unsigned short)(model->Fetch + Cycles);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_BuildCycleCosts
+ * Looks every OpCode up under every timing model, so the cores only index a table.
+ * Run once through Chip8_CycleCostsOnce, machines created on several threads
+ * at once all wait for the tables rather than racing to fill them.
+ *
+ * Parameters:
+ * None.
+ *
+ * Returns:
+ * void.
+ */
+static void Chip8_BuildCycleCosts(void)
+{
+  for (int timing = 0; timing < CHIP8_TIMING_COUNT; timing++)
+  {
+    for (int OpCode = 0; OpCode < 65536; OpCode++)
+    {
+      Chip8_CycleCostTables[timing][OpCode] = Chip8_OpCodeCycles(&Chip8_TimingModels[timing], (unsigned short)OpCode);
+    }
+  }
+}
+
+#ifdef _WIN32
+static BOOL CALLBACK Chip8_BuildCycleCostsOnce(PINIT_ONCE once, PVOID parameter, PVOID *context)
+{
+  Chip8_BuildCycleCosts();
+  return TRUE;
+}
+#endif
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_SetTiming
+ * Picks the timing model that decides how many cycles each instruction
+ * takes. The VIP and SuperChip models also set the machine's speed to their
+ * clock, the flat model keeps whatever speed the machine has. Every core
+ * counts the same cycles, so they still all end up in the same state.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to change.
+ * int timing - One of CHIP8_TIMINGS.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_SetTiming(Chip8_Machine *chip8, int timing)
+{
+  if (timing < 0 || timing >= CHIP8_TIMING_COUNT)
+  {
+    timing = CHIP8_TIMING_FLAT;
+  }
+
+#ifdef _WIN32
+  InitOnceExecuteOnce(&Chip8_CycleCostsOnce, Chip8_BuildCycleCostsOnce, NULL, NULL);
+#else
+  pthread_once(&Chip8_CycleCostsOnce, Chip8_BuildCycleCosts);
+#endif
+
+  chip8->Timing = timing;
+  chip8->TimingModel = &Chip8_TimingModels[timing];
+  chip8->CycleCosts = Chip8_CycleCostTables[timing];
+
+  // Decoded and translated instructions carry the old costs, the sites fused in them are decoded again.
+  memset(chip8->DecodeCache, 0, sizeof(chip8->DecodeCache));
+  memset(chip8->FusedSites, 0, sizeof(chip8->FusedSites));
+  Chip8_JitFlush(chip8->Jit);
+
+  if (chip8->TimingModel->CyclesPerSecond > 0)
+  {
+    Chip8_SetSpeed(chip8, chip8->TimingModel->CyclesPerSecond);
+  }
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ScheduleKeys
+ * Delivers a keypad state once the machine reaches a cycle. Input scheduled
+ * by cycle, rather than set whenever the host gets to it, replays exactly.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine receiving the key states.
+ * uint64_t cycle - The cycle to deliver them at, chip8->Cycles for the next instruction.
+ * unsigned short keys - One bit per Chip8 key, as returned by Chip8_ReadKeys.
+ *
+ * Returns:
+ * int - 1 if the keys were scheduled, 0 if too many events are already waiting.
+ */
+int Chip8_ScheduleKeys(Chip8_Machine *chip8, uint64_t cycle, unsigned short keys)
+{
+  return Chip8_QueueEvent(chip8, cycle, CHIP8_EVENT_KEYS, keys);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_SetSeed
+ * Restarts the machine's random numbers from a seed. CXKK draws from the
+ * machine rather than the C library, so a seed replays the same on any host.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to seed.
+ * uint32_t seed - The seed, also used again by Chip8_Initialise.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_SetSeed(Chip8_Machine *chip8, uint32_t seed)
+{
+  chip8->RandomSeed = seed;
+
+  // Xorshift never leaves zero, so start that seed somewhere else.
+  chip8->RandomState = seed != 0 ? seed : 0x9E3779B9;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_Random
+ * Returns the next random byte for CXKK from a 32 bit xorshift generator.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to draw from.
+ *
+ * Returns:
+ * unsigned char - The random byte.
+ */
+unsigned char Chip8_Random(Chip8_Machine *chip8)
+{
+  uint32_t x = chip8->RandomState;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  chip8->RandomState = x;
+
+  // The top bits are the best mixed.
+  return (unsigned char)(x >> 24);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_StateHash
+ * Hashes everything that decides what the machine does next, so two runs
+ * can be compared with one number. The decode cache, renderer state and
+ * statistics are left out, they differ between cores without changing
+ * what the program sees.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to hash.
+ *
+ * Returns:
+ * uint64_t - A 64 bit FNV-1a hash of the machine state.
+ */
+uint64_t Chip8_StateHash(Chip8_Machine *chip8)
+{
+  const struct
+  {
+    const void *Data;
+    size_t Size;
+  } Parts[] = {
+      {chip8->ProgramMemory, sizeof(chip8->ProgramMemory)},
+      {chip8->DisplayMemory, sizeof(chip8->DisplayMemory)},
+      {chip8->VRegister, sizeof(chip8->VRegister)},
+      {chip8->HP48Registers, sizeof(chip8->HP48Registers)},
+      {&chip8->IndexRegister, sizeof(chip8->IndexRegister)},
+      {&chip8->ProgramCounter, sizeof(chip8->ProgramCounter)},
+      {&chip8->DelayTimer, sizeof(chip8->DelayTimer)},
+      {&chip8->SoundTimer, sizeof(chip8->SoundTimer)},
+      {chip8->Stack, sizeof(chip8->Stack)},
+      {&chip8->StackPointer, sizeof(chip8->StackPointer)},
+      {chip8->KeyStates, sizeof(chip8->KeyStates)},
+      {&chip8->RunState, sizeof(chip8->RunState)},
+      {&chip8->Super, sizeof(chip8->Super)},
+      {&chip8->ScreenWidth, sizeof(chip8->ScreenWidth)},
+      {&chip8->ScreenHeight, sizeof(chip8->ScreenHeight)},
+      {&chip8->Cycles, sizeof(chip8->Cycles)},
+      {&chip8->RandomState, sizeof(chip8->RandomState)}};
+  uint64_t Hash = 0xCBF29CE484222325ULL;
+
+  for (size_t part = 0; part < sizeof(Parts) / sizeof(Parts[0]); part++)
+  {
+    const unsigned char *bytes = Parts[part].Data;
+    for (size_t i = 0; i < Parts[part].Size; i++)
+    {
+      Hash = (Hash ^ bytes[i]) * 0x100000001B3ULL;
+    }
+  }
+
+  return Hash;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ExecuteDecoded
+ * Executes the instruction at the program counter through the decode cache.
+ *
+ * Instructions are decoded the first time they are executed and kept in the
+ * machine's decode cache, so later visits to the same address skip straight
+ * to the handler. Writes to program memory invalidate the affected entries.
+ * A superinstruction runs its whole sequence when its last instruction would
+ * still start within the cycles left.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to step.
+ * int cycles - The cycles left, at least one. The last instruction started
+ * is charged in full, so the cycles used can overshoot this.
+ *
+ * Returns:
+ * int - The number of cycles used, negated if the instruction executed set
+ * chip8->StopReason.
+ */
+static inline int Chip8_ExecuteDecoded(Chip8_Machine *chip8, int cycles)
+{
+  Chip8_Instruction *ins = &chip8->DecodeCache[chip8->ProgramCounter & 0xFFF];
+
+  // Decode the instruction if this is the first visit since it was last written.
+  if (ins->Handler == NULL)
+  {
+    ins = Chip8_DecodeInstruction(chip8, chip8->ProgramCounter);
+  }
+
+  // Process the OpCode.
+  chip8->OpCode = ins->OpCode;
+  if (ins->Fused != NULL && ins->Lead < cycles)
+  {
+    return ins->Fused(chip8, ins, cycles);
+  }
+  ins->Handler(chip8, ins);
+  return ins->Cost;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_EmulateCPU
+ * Emulates one cycle of the Chip8 CPU, then runs any events it brought due.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to step.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_EmulateCPU(Chip8_Machine *chip8)
+{
+  Chip8_EmulateCycles(chip8, 1);
+}
+
+//------------------------------------------------------------------------------
+
+// The threaded core needs the GCC / Clang "labels as values" extension,
+// other compilers get the same handlers behind a switch.
+#if defined(__GNUC__) && !defined(CHIP8_NO_COMPUTED_GOTO)
+#define CHIP8_COMPUTED_GOTO
+#endif
+
+// Stop GCC merging the copies of the dispatch code back into a single jump.
+#if defined(CHIP8_COMPUTED_GOTO) && !defined(__clang__)
+#define CHIP8_THREADED_ATTRIBUTES __attribute__((optimize("no-gcse", "no-crossjumping")))
+#else
+#define CHIP8_THREADED_ATTRIBUTES
+#endif
+
+// One copy of the threaded core for each profile, see chip8threaded.h.
+#define CHIP8_THREADED_NAME Chip8_EmulateThreadedDefault
+#define CHIP8_THREADED_QUIRKS CHIP8_QUIRKS_DEFAULT
+#include "chip8threaded.h"
+
+#define CHIP8_THREADED_NAME Chip8_EmulateThreadedChip8
+#define CHIP8_THREADED_QUIRKS CHIP8_QUIRKS_CHIP8
+#include "chip8threaded.h"
+
+#define CHIP8_THREADED_NAME Chip8_EmulateThreadedSchip10
+#define CHIP8_THREADED_QUIRKS CHIP8_QUIRKS_SCHIP10
+#include "chip8threaded.h"
+
+#define CHIP8_THREADED_NAME Chip8_EmulateThreadedSchip11
+#define CHIP8_THREADED_QUIRKS CHIP8_QUIRKS_SCHIP11
+#include "chip8threaded.h"
+
+#define CHIP8_THREADED_NAME Chip8_EmulateThreadedXoChip
+#define CHIP8_THREADED_QUIRKS CHIP8_QUIRKS_XOCHIP
+#include "chip8threaded.h"
+
+// The threaded core for each of CHIP8_PROFILES.
+static int (*const Chip8_ThreadedCores[CHIP8_PROFILE_COUNT])(Chip8_Machine *chip8, int cycles) = {
+    Chip8_EmulateThreadedDefault, Chip8_EmulateThreadedChip8, Chip8_EmulateThreadedSchip10,
+    Chip8_EmulateThreadedSchip11, Chip8_EmulateThreadedXoChip};
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_EmulateJit
+ * JIT core, runs translated basic blocks and hands anything the JIT can't
+ * translate to the decoded core one instruction at a time. Translated code
+ * never stops early, so only the decoded instructions are checked.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to run.
+ * int cycles - The cycles to run for.
+ *
+ * Returns:
+ * int - The number of cycles used.
+ */
+static int Chip8_EmulateJit(Chip8_Machine *chip8, int cycles)
+{
+  int Executed = 0;
+
+  while (Executed < cycles)
+  {
+    int blockCycles = 0;
+    Chip8_JitBlock block = Chip8_JitGetBlock(chip8, chip8->ProgramCounter, &blockCycles);
 
-    case 0x0085:
-      // Read from HP48 Registers a fill the CHIP8 Registers V[0]-V[x].
-      for (int c = 0; c <= x; c++)
+    // A block always runs to its end, so only enter one that fits in the cycles left.
+    if (block != NULL && blockCycles <= cycles - Executed)
+    {
+      Executed += block(chip8);
+    }
+    else
+    {
+      int executed = Chip8_ExecuteDecoded(chip8, cycles - Executed);
+      if (executed < 0)
       {
-        Chip8_VRegister[c] = Chip8_HP48Registers[c];
+        return Executed - executed;
       }
-      Chip8_ProgramCounter += 2;
-      break;
-
-    default:
-      break;
+      Executed += executed;
     }
-    break;
   }
+  return Executed;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_EmulateCompiled
+ * Compiled core, runs the regions of a ROM compiled by chip8aot and hands
+ * any address they don't cover to the decoded core one instruction at a time.
+ * Regions leave as soon as an instruction they interpret stops the run.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to run.
+ * int cycles - The cycles to run for.
+ *
+ * Returns:
+ * int - The number of cycles used.
+ */
+static int Chip8_EmulateCompiled(Chip8_Machine *chip8, int cycles)
+{
+  int Executed = 0;
 
-  // Is it time to decrement the Chip8_DelayTimer. (0.016666 = one second / 60 = 60hz)
-  if (CurrentTime - Last_DelayUpdate > 0.01666)
+  while (Executed < cycles)
   {
-    if (Chip8_DelayTimer > 0)
+    int executed = 0;
+
+    if (chip8->Compiled != NULL)
     {
-      Chip8_DelayTimer--;
+      Chip8_CompiledBlock block = chip8->Compiled->Blocks[chip8->ProgramCounter & 0xFFF];
+      if (block != NULL)
+      {
+        executed = block(chip8, cycles - Executed);
+      }
     }
-    Last_DelayUpdate = CurrentTime;
-  }
 
-  // Is it time to decrement the Chip8_SoundTimer. (0.01666 = one second / 60 = 60hz)
-  // No sound implemented at the moment, enjoy the silence!
-  if (CurrentTime - LastSoundUpdate > 0.01666)
-  {
-    if (Chip8_SoundTimer > 0)
+    if (executed == 0)
     {
-      Chip8_SoundTimer = Chip8_SoundTimer - 1;
+      executed = Chip8_ExecuteDecoded(chip8, cycles - Executed);
+      if (executed < 0)
+      {
+        return Executed - executed;
+      }
+    }
+    Executed += executed;
+    if (chip8->StopReason)
+    {
+      break;
     }
-    LastSoundUpdate = CurrentTime;
   }
+  return Executed;
 }
 
 //------------------------------------------------------------------------------
 
 /*
- * Function: Chip8_GetKeyStates
- * Processes and stores the Chip8 keyboard state.
+ * Function: Chip8_Step
+ * Executes a single instruction without servicing the timers.
+ * Used by compiled ROMs for the instructions they leave to the interpreter.
  *
  * Parameters:
- * Tigr *screen
+ * Chip8_Machine *chip8 - The machine to run.
  *
  * Returns:
  * void.
  */
-void Chip8_GetKeyStates(Tigr *screen)
+void Chip8_Step(Chip8_Machine *chip8)
 {
-  // 0x1, 1
-  if (tigrKeyDown(screen, '1') || tigrKeyHeld(screen, '1'))
-  {
-    Chip8_KeyStates[0x1] = CHIP8_KEYDOWN;
-  }
-  else
-  {
-    Chip8_KeyStates[0x1] = CHIP8_KEYUP;
-  }
-
-  // 0x2, 2
-  if (tigrKeyDown(screen, '2') || tigrKeyHeld(screen, '2'))
-  {
-    Chip8_KeyStates[0x2] = CHIP8_KEYDOWN;
-  }
-  else
-  {
-    Chip8_KeyStates[0x2] = CHIP8_KEYUP;
-  }
-
-  // 0x3, 3
-  if (tigrKeyDown(screen, '3') || tigrKeyHeld(screen, '3'))
-  {
-    Chip8_KeyStates[0x3] = CHIP8_KEYDOWN;
-  }
-  else
-  {
-    Chip8_KeyStates[0x3] = CHIP8_KEYUP;
-  }
-
-  // 0xc, 4
-  if (tigrKeyDown(screen, '4') || tigrKeyHeld(screen, '4'))
-  {
-    Chip8_KeyStates[0xC] = CHIP8_KEYDOWN;
-  }
-  else
-  {
-    Chip8_KeyStates[0xC] = CHIP8_KEYUP;
-  }
-
-  // 0x4,  Q
-  if (tigrKeyDown(screen, 'Q') || tigrKeyHeld(screen, 'Q'))
-  {
-    Chip8_KeyStates[0x4] = CHIP8_KEYDOWN;
-  }
-  else
-  {
-    Chip8_KeyStates[0x4] = CHIP8_KEYUP;
-  }
+  Chip8_ExecuteDecoded(chip8, 1);
+}
 
-  // 0x5,  W
-  if (tigrKeyDown(screen, 'W') || tigrKeyHeld(screen, 'W'))
-  {
-    Chip8_KeyStates[0x5] = CHIP8_KEYDOWN;
-  }
-  else
-  {
-    Chip8_KeyStates[0x5] = CHIP8_KEYUP;
-  }
+//------------------------------------------------------------------------------
 
-  // 0x6, E
-  if (tigrKeyDown(screen, 'E') || tigrKeyHeld(screen, 'E'))
-  {
-    Chip8_KeyStates[0x6] = CHIP8_KEYDOWN;
-  }
-  else
-  {
-    Chip8_KeyStates[0x6] = CHIP8_KEYUP;
-  }
+/*
+ * Function: Chip8_RunCore
+ * Runs the number of cycles given on the machine's selected core, with
+ * nothing in between, unless an instruction sets chip8->StopReason first.
+ * Instructions start while the cycles used are below the budget and are
+ * charged in full, so the last one can overshoot it, and the stopping
+ * instruction is charged too. Every core leaves the machine in exactly the
+ * same state.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to run.
+ * int cycles - The cycles to run for.
+ *
+ * Returns:
+ * int - The number of cycles used.
+ */
+static int Chip8_RunCore(Chip8_Machine *chip8, int cycles)
+{
+  int Executed = 0;
 
-  // 0xD, R
-  if (tigrKeyDown(screen, 'R') || tigrKeyHeld(screen, 'R'))
-  {
-    Chip8_KeyStates[0xD] = CHIP8_KEYDOWN;
-  }
-  else
-  {
-    Chip8_KeyStates[0xD] = CHIP8_KEYUP;
-  }
+  chip8->StopReason = CHIP8_EXIT_BUDGET;
 
-  // 0x7, A
-  if (tigrKeyDown(screen, 'A') || tigrKeyHeld(screen, 'A'))
-  {
-    Chip8_KeyStates[0x7] = CHIP8_KEYDOWN;
-  }
-  else
+  switch (chip8->Core)
   {
-    Chip8_KeyStates[0x7] = CHIP8_KEYUP;
-  }
+  case CHIP8_CORE_THREADED:
+    return Chip8_ThreadedCores[chip8->LoadedProfile](chip8, cycles);
 
-  // 0x8, S
-  if (tigrKeyDown(screen, 'S') || tigrKeyHeld(screen, 'S'))
-  {
-    Chip8_KeyStates[0x8] = CHIP8_KEYDOWN;
-  }
-  else
-  {
-    Chip8_KeyStates[0x8] = CHIP8_KEYUP;
-  }
+  case CHIP8_CORE_COMPILED:
+    return Chip8_EmulateCompiled(chip8, cycles);
 
-  // 0x9, D
-  if (tigrKeyDown(screen, 'D') || tigrKeyHeld(screen, 'D'))
-  {
-    Chip8_KeyStates[0x9] = CHIP8_KEYDOWN;
-  }
-  else
-  {
-    Chip8_KeyStates[0x9] = CHIP8_KEYUP;
-  }
+  case CHIP8_CORE_JIT:
+    if (chip8->Jit == NULL)
+    {
+      chip8->Jit = Chip8_JitCreate();
+    }
+    if (chip8->Jit != NULL)
+    {
+      return Chip8_EmulateJit(chip8, cycles);
+    }
 
-  // 0xE, F
-  if (tigrKeyDown(screen, 'F') || tigrKeyHeld(screen, 'F'))
-  {
-    Chip8_KeyStates[0xE] = CHIP8_KEYDOWN;
-  }
-  else
-  {
-    Chip8_KeyStates[0xE] = CHIP8_KEYUP;
-  }
+    // No JIT on this host, stay on the decoded core from now on.
+    chip8->Core = CHIP8_CORE_DECODED;
+    // fall through
 
-  // 0xA, Z
-  if (tigrKeyDown(screen, 'Z') || tigrKeyHeld(screen, 'Z'))
-  {
-    Chip8_KeyStates[0xA] = CHIP8_KEYDOWN;
-  }
-  else
-  {
-    Chip8_KeyStates[0xA] = CHIP8_KEYUP;
+  case CHIP8_CORE_DECODED:
+  default:
+    while (Executed < cycles)
+    {
+      int executed = Chip8_ExecuteDecoded(chip8, cycles - Executed);
+      if (executed < 0)
+      {
+        return Executed - executed;
+      }
+      Executed += executed;
+    }
+    return Executed;
   }
+}
 
-  // 0x0, X
-  if (tigrKeyDown(screen, 'X') || tigrKeyHeld(screen, 'X'))
-  {
-    Chip8_KeyStates[0x0] = CHIP8_KEYDOWN;
-  }
-  else
-  {
-    Chip8_KeyStates[0x0] = CHIP8_KEYUP;
-  }
+//------------------------------------------------------------------------------
 
-  // 0xB, C
-  if (tigrKeyDown(screen, 'C') || tigrKeyHeld(screen, 'C'))
-  {
-    Chip8_KeyStates[0xB] = CHIP8_KEYDOWN;
-  }
-  else
-  {
-    Chip8_KeyStates[0xB] = CHIP8_KEYUP;
-  }
+/*
+ * Function: Chip8_SetBreakpoint
+ * Sets or clears a breakpoint, Chip8_Run stops before executing the
+ * instruction at its address. Breakpoints are kept across resets.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to change.
+ * unsigned short address - The address of the instruction.
+ * int set - 1 to set the breakpoint, 0 to clear it.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_SetBreakpoint(Chip8_Machine *chip8, unsigned short address, int set)
+{
+  uint64_t *Word = &chip8->Breakpoints[(address & 0xFFF) >> 6];
+  uint64_t Bit = (uint64_t)1 << (address & 63);
 
-  // 0xF  V
-  if (tigrKeyDown(screen, 'V') || tigrKeyHeld(screen, 'V'))
+  if (set && !(*Word & Bit))
   {
-    Chip8_KeyStates[0xF] = CHIP8_KEYDOWN;
+    *Word |= Bit;
+    chip8->BreakpointCount++;
   }
-  else
+  else if (!set && (*Word & Bit))
   {
-    Chip8_KeyStates[0xF] = CHIP8_KEYUP;
+    *Word &= ~Bit;
+    chip8->BreakpointCount--;
   }
 }
 
 //------------------------------------------------------------------------------
 
 /*
- * Function: main
- * Main entry point for the application.
+ * Function: Chip8_Run
+ * Runs the machine for up to a number of cycles in one call and says why it
+ * stopped. The core is handed every cycle up to the next event in one go,
+ * with the events run in between.
+ *
+ * Timers and keys only change in events, so within a run of cycles the core
+ * never checks a clock. The decoded core skips the rest of the run once the
+ * program is stuck in a loop waiting for the delay timer or a key, and sets
+ * chip8->Idle. A machine halted on FX0A executes nothing and its cycles pass
+ * straight to the next event, unless asked to stop instead. So does one
+ * waiting for the next frame after drawing with CHIP8_QUIRK_DISPLAYWAIT.
+ *
+ * With breakpoints set the core is handed one instruction at a time. The
+ * first instruction of a run never stops on its breakpoint, so running again
+ * carries on past it.
  *
  * Parameters:
- * int argc     - Number of command line parameters
- * char *argv[] - Array of the the command line parameters
+ * Chip8_Machine *chip8 - The machine to run.
+ * int cycles - The most cycles to run, chip8->Cycles counts those that passed.
+ * int stopOn - CHIP8_STOP_VBLANK and CHIP8_STOP_KEYWAIT, or 0 for neither.
  *
  * Returns:
- * int.
+ * int - Why the run stopped, one of CHIP8_EXITS.
  */
-int main(int argc, char *argv[])
+int Chip8_Run(Chip8_Machine *chip8, int cycles, int stopOn)
 {
-  Tigr *screen = NULL;
-  char ROM_FileName[1024] = {'\0'};
-
-  // Initialise the applications window
-  screen = tigrWindow(CLIENTWIDTH, CLIENTHEIGHT, "Super Chip", TIGR_FIXED);
+  int Executed = 0;
+  int Reason = CHIP8_EXIT_BUDGET;
 
-  // Clear the client window contents before we start.
-  tigrClear(screen, BACKGROUND);
+  chip8->Idle = 0;
+  chip8->VBlank = 0;
 
-  // Initialise the Chip8 registers
-  Chip8_Initialise();
+  // Keys may have been scheduled for this very cycle.
+  Chip8_RunEvents(chip8);
 
-  // No command line passed, so browse for a CHIP8 ROM file instead.
-  if (argc == 1)
+  while (Executed < cycles)
   {
-    OpenFileDialog(ROM_FileName, sizeof(ROM_FileName));
-    if (strlen(ROM_FileName) > 0)
+    // Nothing more runs after 00FD until the machine is reset.
+    if (chip8->RunState == CHIP8_EXITED)
     {
-      // Load the selected ROM file.
-      Chip8_LoadROM(ROM_FileName);
+      Reason = CHIP8_EXIT_EXIT;
+      break;
     }
-  }
-
-  // Load the ROM file passed on the command line
-  else if (argc == 2)
-  {
-    Chip8_LoadROM(argv[1]);
-    strcpy(ROM_FileName, argv[1]);
-  }
-
-#ifdef NDEBUG
-  Console_Show("Debug Window");
-#endif
-
-  // Loop until the user exits.
-  while (!tigrClosed(screen) && !tigrKeyDown(screen, TK_ESCAPE))
-  {
-    // Clear the background
-    tigrClear(screen, BACKGROUND);
 
-    // Only emulate one cycle per feame, if NDEUG set.
-#ifndef NDEBUG
-    for (int n = 0; n < CHIP8TICKSPERFRAME; n++)
-#endif
+    // Run straight up to the next event, there is always a 60Hz one waiting.
+    int Slice = cycles - Executed;
+    uint64_t Next = chip8->Events[0].Cycle - chip8->Cycles;
+    if (Next < (uint64_t)Slice)
     {
-      CurrentTime += tigrTime();
+      Slice = (int)Next;
+    }
 
-#ifdef NDEBUG
-      // Disassemble the current command.
-      Chip8_Disassemble();
-#endif
+    // Halted on FX0A, only the events run until a key is pressed.
+    if (chip8->RunState == CHIP8_WAITING_FOR_KEY && Chip8_KeyPressed(chip8))
+    {
+      chip8->RunState = CHIP8_RUNNING;
+    }
 
-#ifdef NDEBUG
-      if (tigrKeyDown(screen, TK_RIGHT) || tigrKeyHeld(screen, TK_RIGHT))
-      {
-        Chip8_EmulateCPU();
-      }
+    chip8->Idle = (chip8->RunState == CHIP8_WAITING_FOR_KEY || chip8->RunState == CHIP8_WAITING_FOR_VBLANK);
+    if (chip8->RunState == CHIP8_WAITING_FOR_KEY && (stopOn & CHIP8_STOP_KEYWAIT))
+    {
+      Reason = CHIP8_EXIT_KEYWAIT;
+      break;
+    }
 
-      if (tigrKeyDown(screen, TK_LEFT))
+    if (!chip8->Idle)
+    {
+      if (chip8->BreakpointCount > 0)
       {
-        Chip8_ProgramCounter -= 2;
-        if (Chip8_ProgramCounter <= 512)
+        unsigned short PC = chip8->ProgramCounter & 0xFFF;
+        if (Executed > 0 && (chip8->Breakpoints[PC >> 6] >> (PC & 63) & 1))
         {
-          Chip8_ProgramCounter = 512;
+          Reason = CHIP8_EXIT_BREAKPOINT;
+          break;
         }
-        Chip8_Disassemble();
-        Chip8_EmulateCPU();
+        Slice = 1;
       }
+      // Sprites charge the rows they drew once the slice is over.
+      Slice = Chip8_RunCore(chip8, Slice) + chip8->StallCycles;
+      chip8->StallCycles = 0;
+    }
 
-#else
-      // Emulate a cpu cycle.
-      Chip8_EmulateCPU();
-#endif
+    chip8->Cycles += Slice;
+    Executed += Slice;
 
-      // Process the keypress states.
-      Chip8_GetKeyStates(screen);
+    chip8->VBlank = 0;
+    Chip8_RunEvents(chip8);
 
-#ifdef NDEBUG
-      // Show the chip register states.
-      Chip8_ShowProgramState();
-#endif
+    // The instruction stopping the core has had its cycle, and the events due with it have run.
+    if (!chip8->Idle && chip8->StopReason == CHIP8_EXIT_INVALID)
+    {
+      Reason = CHIP8_EXIT_INVALID;
+      break;
+    }
+    if (chip8->RunState == CHIP8_EXITED)
+    {
+      Reason = CHIP8_EXIT_EXIT;
+      break;
+    }
+    if ((stopOn & CHIP8_STOP_VBLANK) && chip8->VBlank)
+    {
+      Reason = CHIP8_EXIT_VBLANK;
+      break;
+    }
+  }
 
-      // Reload the current rom if 'L' pressed
-      if (tigrKeyDown(screen, 'L'))
-      {
-        Chip8_Initialise();
-        Chip8_LoadROM(ROM_FileName);
-      }
+  return Reason;
+}
 
-      // Open a different ROM file if 'O' pressed
-      if (tigrKeyDown(screen, 'O'))
-      {
-        OpenFileDialog(ROM_FileName, sizeof(ROM_FileName));
-        if (strlen(ROM_FileName) > 0)
-        {
-          // Load the selected ROM file.
-          Chip8_Initialise();
-          Chip8_LoadROM(ROM_FileName);
-        }
-      }
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_EmulateCycles
+ * Emulates a number of Chip8 CPU cycles using the machine's selected core,
+ * running the timer, vblank and key events that fall due along the way.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to run.
+ * int cycles - The number of machine cycles to run, fewer if the program
+ * stops first. Use Chip8_Run to find out why.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_EmulateCycles(Chip8_Machine *chip8, int cycles)
+{
+  Chip8_Run(chip8, cycles, 0);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_EmulateFrame
+ * Emulates up to the end of the current 60Hz frame, a sixtieth of the
+ * machine's cycles per second.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to run.
+ *
+ * Returns:
+ * int - Why the frame ended, CHIP8_EXIT_VBLANK unless the program stopped it.
+ */
+int Chip8_EmulateFrame(Chip8_Machine *chip8)
+{
+  return Chip8_Run(chip8, chip8->CyclesPerSecond, CHIP8_STOP_VBLANK);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ReadKeys
+ * Reads the Chip8 keypad from the keyboard.
+ *
+ *   1 2 3 4        1 2 3 C
+ *   Q W E R   ->   4 5 6 D
+ *   A S D F        7 8 9 E
+ *   Z X C V        A 0 B F
+ *
+ * Parameters:
+ * Tigr *screen - The window to read the keys from.
+ *
+ * Returns:
+ * unsigned short - One bit per Chip8 key, bit n set when key n is down.
+ */
+unsigned short Chip8_ReadKeys(Tigr *screen)
+{
+  static const char KeyMap[16] = {'X', '1', '2', '3', 'Q', 'W', 'E', 'A', 'S', 'D', 'Z', 'C', '4', 'R', 'F', 'V'};
+  unsigned short Keys = 0;
+
+  for (int key = 0; key < 16; key++)
+  {
+    if (tigrKeyDown(screen, KeyMap[key]) || tigrKeyHeld(screen, KeyMap[key]))
+    {
+      Keys |= 1 << key;
     }
+  }
+  return Keys;
+}
+
+//------------------------------------------------------------------------------
 
-    // Update the chip8 screen.
-    Chip8_DrawScreen(screen);
+/*
+ * Function: Chip8_SetKeyStates
+ * Stores the Chip8 keyboard state.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine receiving the key states.
+ * unsigned short keys - One bit per Chip8 key, as returned by Chip8_ReadKeys.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_SetKeyStates(Chip8_Machine *chip8, unsigned short keys)
+{
+  for (int key = 0; key < 16; key++)
+  {
+    chip8->KeyStates[key] = (keys & (1 << key)) ? CHIP8_KEYDOWN : CHIP8_KEYUP;
+  }
 
-    // Tell Tigr to update.
-    tigrUpdate(screen);
+  // A key press wakes a machine halted on FX0A.
+  if (chip8->RunState == CHIP8_WAITING_FOR_KEY && Chip8_KeyPressed(chip8))
+  {
+    chip8->RunState = CHIP8_RUNNING;
   }
+}
 
-  // Close the window and shut down Tigr.
-  tigrFree(screen);
+//------------------------------------------------------------------------------
 
-  // Return to the OS.
-  return EXIT_SUCCESS;
+/*
+ * Function: Chip8_GetKeyStates
+ * Processes and stores the Chip8 keyboard state.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine receiving the key states.
+ * Tigr *screen
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_GetKeyStates(Chip8_Machine *chip8, Tigr *screen)
+{
+  Chip8_SetKeyStates(chip8, Chip8_ReadKeys(screen));
 }
+
+//------------------------------------------------------------------------------
@@ -27,10 +27,12 @@
 #define BACKGROUND tigrRGB( 0,160, 60 )
 #define FOREGROUND tigrRGB( 50, 50, 50 )
 
-int CHIP8_SUPER = 0;                                // Flag which mode the Virtual Machine is in.
+#include <stdint.h>
 
-int CHIP8_SCREENWIDTH = 64;                         // Default CHIP8 Screen Width.
-int CHIP8_SCREENHEIGHT = 32;                        // Default CHIP8 Screen Height.
+#include "tigr.h"
+
+extern const int CLIENTWIDTH;                       // Width of the window's bitmap, tigr scales it to the window.
+extern const int CLIENTHEIGHT;                      // Height of the window's bitmap.
 
 enum CHIP8_KEYSTATES
 {
@@ -38,128 +40,268 @@ enum CHIP8_KEYSTATES
     CHIP8_KEYDOWN = 1
 };
 
-// Current Chip8_OpCode.
-unsigned short  Chip8_OpCode;                       // Current Chip8_OpCode.
-
-// Program Memory.
-unsigned char   Chip8_ProgramMemory[4096];          // Chip 8's Main Memory.
-
-// Display Memory.
-unsigned char   Chip8_DisplayMemory[8192];          // Chip 8 Display 2048 = (64 * 32) 8192 = (128 * 64)
-
-// Various Registers.
-unsigned char   Chip8_VRegister[16];                // Chip8's 16 Registers.
-unsigned char   Chip8_HP48Registers[16];            // Addition registers for SuperChip instructions.
-unsigned short  Chip8_IndexRegister;                // Chip8's Index register.
-unsigned short  Chip8_ProgramCounter;               // Program counter.
-
-// Timers.
-unsigned char   Chip8_DelayTimer;                   // Delay Timer.
-unsigned char   Chip8_SoundTimer;                   // Sound Timer.
-
-// Chip8 Call Stack and Pointer.
-unsigned short  Chip8_Stack[16];                    // Chip8's stack.
-unsigned short  Chip8_StackPointer;                 // Stack pointer.
-
-// Chip8 Key States.
-unsigned char   Chip8_KeyStates[16];                // Store key states.
-
-// Screen Update Flag.
-unsigned char   Chip8_DrawFlag;                     // Okay to redraw screen.
-
-// Chip 8 Default Fonts.
-unsigned char Chip8_FontSet[80] =  {
-    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-    0x20, 0x60, 0x20, 0x20, 0x70, // 1
-    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-    0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+// What the CPU is doing.
+enum CHIP8_RUNSTATES
+{
+    CHIP8_RUNNING = 0,                              // Executing instructions.
+    CHIP8_WAITING_FOR_KEY = 1,                      // Halted on FX0A until a key is pressed.
+    CHIP8_EXITED = 2,                               // Stopped by 00FD until the machine is reset.
+    CHIP8_WAITING_FOR_VBLANK = 3                    // Halted after DXYN until the next frame, with CHIP8_QUIRK_DISPLAYWAIT.
 };
 
+// Why Chip8_Run stopped.
+enum CHIP8_EXITS
+{
+    CHIP8_EXIT_BUDGET = 0,                          // Ran every cycle it was given.
+    CHIP8_EXIT_VBLANK = 1,                          // Reached the end of a frame, with CHIP8_STOP_VBLANK.
+    CHIP8_EXIT_KEYWAIT = 2,                         // Halted on FX0A with no key down, with CHIP8_STOP_KEYWAIT.
+    CHIP8_EXIT_BREAKPOINT = 3,                      // About to execute an instruction with a breakpoint on it.
+    CHIP8_EXIT_INVALID = 4,                         // Executed an unknown OpCode, the program counter is left on it.
+    CHIP8_EXIT_EXIT = 5                             // The program ended with 00FD.
+};
+
+// Optional reasons for Chip8_Run to stop early, breakpoints, unknown OpCodes and 00FD always stop it.
+#define CHIP8_STOP_VBLANK   0x01                    // Stop at the end of the frame.
+#define CHIP8_STOP_KEYWAIT  0x02                    // Stop once halted on FX0A rather than letting the cycles pass.
+
+// The interpreter cores a machine can run on.
+enum CHIP8_CORES
+{
+    CHIP8_CORE_DECODED = 0,                         // Handlers called through the pre-decoded instruction cache.
+    CHIP8_CORE_THREADED = 1,                        // Threaded dispatch on the top nibble of each OpCode.
+    CHIP8_CORE_JIT = 2,                             // Basic blocks translated to x86-64, falls back to CHIP8_CORE_DECODED.
+    CHIP8_CORE_COMPILED = 3                         // ROMs compiled ahead of time by chip8aot, falls back to CHIP8_CORE_DECODED.
+};
 
-// high-res mode font sprites ('0'-'F')
-unsigned char Chip8_SuperFontSet[160] =  {
-    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
-    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
-    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
-    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
-    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
-    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
-    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
-    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
-    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
-    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
-    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
-    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
-    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
-    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
-    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
-    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+// Pixel art filters Chip8_DrawScreen can scale the display up with.
+enum CHIP8_FILTERS
+{
+    CHIP8_FILTER_NONE = 0,                          // Square pixels.
+    CHIP8_FILTER_SCALE2X = 1,                       // Scale2x / EPX, rounds off diagonals at twice the size.
+    CHIP8_FILTER_SCALE3X = 2                        // Scale3x, the same at three times the size.
 };
 
-// Our Default Chip8 ROM.
-unsigned char Chip8_LogoRom[] = {
-    0x00,0xFF,0xA2,0xE4,0x60,0x00,0x61,0x00,0xD0,0x10,0xA3,0x04,0x60,0x10,0x61,0x00,0xD0,0x10,0xA3,0x24,0x60,0x20,0x61,0x00,0xD0,0x10,0xA3,0x44,0x60,0x30,
-    0x61,0x00,0xD0,0x10,0xA3,0x64,0x60,0x40,0x61,0x00,0xD0,0x10,0xA3,0x84,0x60,0x50,0x61,0x00,0xD0,0x10,0xA3,0xA4,0x60,0x60,0x61,0x00,0xD0,0x10,0xA3,0xC4,
-    0x60,0x70,0x61,0x00,0xD0,0x10,0xA3,0xE4,0x60,0x10,0x61,0x10,0xD0,0x10,0xA4,0x04,0x60,0x20,0x61,0x10,0xD0,0x10,0xA4,0x24,0x60,0x30,0x61,0x10,0xD0,0x10,
-    0xA4,0x44,0x60,0x40,0x61,0x10,0xD0,0x10,0xA4,0x64,0x60,0x50,0x61,0x10,0xD0,0x10,0xA4,0x84,0x60,0x60,0x61,0x10,0xD0,0x10,0xA4,0xA4,0x60,0x10,0x61,0x20,
-    0xD0,0x10,0xA4,0xC4,0x60,0x20,0x61,0x20,0xD0,0x10,0xA4,0xE4,0x60,0x30,0x61,0x20,0xD0,0x10,0xA5,0x04,0x60,0x40,0x61,0x20,0xD0,0x10,0xA5,0x24,0x60,0x50,
-    0x61,0x20,0xD0,0x10,0xA5,0x44,0x60,0x60,0x61,0x20,0xD0,0x10,0xA5,0x64,0x60,0x00,0x61,0x30,0xD0,0x10,0xA5,0x84,0x60,0x10,0x61,0x30,0xD0,0x10,0xA5,0xA4,
-    0x60,0x20,0x61,0x30,0xD0,0x10,0xA5,0xC4,0x60,0x30,0x61,0x30,0xD0,0x10,0xA5,0xE4,0x60,0x40,0x61,0x30,0xD0,0x10,0xA6,0x04,0x60,0x50,0x61,0x30,0xD0,0x10,
-    0xA6,0x24,0x60,0x60,0x61,0x30,0xD0,0x10,0xA6,0x44,0x60,0x70,0x61,0x30,0xD0,0x10,0x12,0xE2,0x00,0x00,0x00,0x00,0x0F,0xF8,0x0F,0xFD,0x2F,0xFD,0x3F,0xF9,
-    0x3F,0x01,0x3F,0xF9,0x1F,0xFD,0x00,0x7D,0x1F,0xFD,0x3F,0xFD,0x3F,0xF8,0x1F,0xF0,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xE1,0xC7,0x33,0xE9,0x73,0xEB,
-    0xF3,0xEF,0xF3,0xEF,0xF3,0xEF,0xF3,0xEF,0xF3,0xEF,0xF3,0xEF,0xFF,0xEF,0xFF,0xCF,0x7F,0x87,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0x3F,0xFE,0x4F,
-    0xFF,0x5F,0x9F,0x7E,0x9F,0x7E,0x9F,0x7F,0xFF,0x7F,0xFE,0x7E,0xFC,0x7E,0x80,0x7F,0x80,0x7F,0x80,0x3F,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xF1,0xFF,
-    0xFA,0x7F,0xF2,0xFF,0x03,0xF3,0x03,0xF3,0xFB,0xFF,0xFB,0xFF,0x03,0xFF,0x03,0xFF,0xF3,0xF7,0xFB,0xF3,0xF1,0xE1,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-    0x00,0x00,0x80,0x00,0xC0,0x01,0xC0,0x01,0xC0,0x01,0x80,0x01,0x00,0x01,0x80,0x01,0xC0,0x01,0xC0,0x01,0xC0,0x00,0x80,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-    0x00,0x00,0x7F,0xC7,0x7F,0xE9,0x7F,0xCB,0xF8,0x0F,0xF8,0x0F,0xF8,0x0F,0xF8,0x0F,0xF8,0x0F,0xF8,0x0F,0xFF,0xCF,0xFF,0xEF,0x7F,0xC7,0x00,0x00,0x00,0x00,
-    0x00,0x00,0x00,0x00,0x0E,0x3C,0x9F,0x4E,0x9F,0x5E,0x9F,0x7E,0x9F,0x7E,0xFF,0x7E,0xFF,0x7E,0x9F,0x7E,0x9F,0x7E,0x9F,0x7E,0x9F,0x7E,0x0E,0x3C,0x00,0x00,
-    0x00,0x00,0x00,0x00,0x00,0x00,0x3F,0xE0,0x4F,0xF0,0x5F,0xF8,0x7C,0xF8,0x7C,0xF8,0x7C,0xF8,0x7F,0xF8,0x7F,0xF0,0x7F,0xE0,0x7C,0x00,0x7C,0x00,0x3C,0x00,
-    0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x3F,0xF0,0x4F,0xF8,0x5F,0xF1,0x7E,0x02,0x7E,0x02,0x7F,0xFB,0x7F,0xFB,0x7E,0x03,0x7E,0x03,0x7F,0xF3,
-    0x7F,0xFB,0x3F,0xF1,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xC3,0x0E,0x67,0x93,0xE7,0x97,0xFF,0x9F,0xFF,0x9F,0xFF,0x9F,0xE7,0x9F,
-    0xE7,0x9F,0xE7,0x8F,0xC3,0x07,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x10,0xE0,0x39,0x30,0x39,0x70,0x39,0xF0,0x39,0xF0,0x39,0xF0,
-    0x39,0xF0,0xF9,0xFE,0xF1,0xFF,0xE0,0xFE,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x1F,0x83,0x1F,0xC4,0x5F,0xE5,0x7C,0xE0,0x7F,0xE0,
-    0x7F,0xE0,0x7C,0xE0,0x7C,0xE0,0x7C,0xE0,0x38,0x40,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0x3F,0xFE,0x3F,0xFE,0xBF,0xF0,0xF9,
-    0xF0,0xF9,0xF0,0xF9,0xF0,0xF9,0xF0,0xFF,0xF0,0x7F,0xF0,0x3F,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x07,0xF0,0x89,0xF8,0xCB,0xFC,
-    0xCF,0x9C,0xCF,0xF8,0xCF,0xF0,0xCF,0xF8,0xCF,0xBC,0x8F,0x9C,0x07,0x08,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x61,0x00,0x31,
-    0x01,0xE7,0x01,0xC7,0x03,0xC7,0x03,0xC7,0x01,0xC7,0x01,0xE7,0x01,0xF7,0x00,0x61,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0x60,
-    0xFE,0xB0,0xC0,0x7C,0xC0,0x3C,0xC0,0x3C,0xC0,0x3C,0xC0,0x3C,0xFC,0xB0,0xFE,0xF0,0xFC,0x60,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-    0x00,0x3F,0x00,0x4F,0x00,0x5F,0x00,0x01,0x00,0x5F,0x00,0x7C,0x00,0x7F,0x00,0x7F,0x00,0x7F,0x00,0x3F,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-    0x00,0x00,0x83,0xF0,0xC3,0xF9,0xEF,0x9D,0xEF,0x9C,0xAF,0x9D,0x0F,0x9D,0xCF,0x9D,0xEF,0xFD,0xEF,0xFD,0xC3,0xF0,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-    0x00,0x00,0x00,0x00,0xFE,0x0F,0x3F,0x13,0x7F,0x97,0x07,0x80,0x7E,0x97,0xF0,0x1F,0xFF,0x1F,0xFF,0x9F,0xFF,0x9F,0xFF,0x0F,0x00,0x00,0x00,0x00,0x00,0x00,
-    0x00,0x00,0x00,0x00,0x00,0x00,0xE0,0x00,0xF0,0x00,0xF8,0x00,0x78,0x00,0xE8,0x00,0x00,0x00,0xF0,0x00,0xF8,0x00,0xF8,0x00,0xF0,0x00,0x00,0x00,0x00,0x00,
-    0x00,0x00,0x00,0x00,0x00,0x00,0x03,0x82,0x04,0xC2,0x05,0xC3,0x07,0xC3,0x07,0xC3,0x07,0xC3,0x07,0xC3,0x07,0xFB,0x07,0xFF,0x03,0xF9,0x00,0x00,0x00,0x00,
-    0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xFF,0x1F,0xFF,0x1F,0xE0,0x7F,0xE1,0x7C,0xFF,0x3F,0xE1,0x01,0xE0,0x3F,0xFE,0x7F,0xFF,0x7F,0xFE,0x3F,0x00,0x00,
-    0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xC0,0x01,0xE0,0x01,0xC0,0x01,0x00,0x01,0xC0,0x01,0xE0,0x01,0xE0,0x01,0xE0,0x01,0xE0,0x01,0x80,0x00,
-    0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x7F,0x8F,0x7F,0x8F,0xF0,0x3E,0xF0,0xBE,0xFF,0xBF,0xFF,0x3E,0xF0,0x3E,0xF0,0x3E,0xF0,0x3E,
-    0xE0,0x1C,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xC5,0xFC,0xC5,0xFE,0x77,0xCE,0x77,0xCE,0xF7,0xFC,0x77,0xF8,0x77,0xFC,0x77,0xDE,
-    0x77,0xCE,0x23,0x84,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xBF,0x8B,0xBF,0xCB,0xF9,0xCF,0xF9,0xCF,0xFF,0x8F,0xFF,0x0F,0xFF,0x8F,
-    0xFB,0xCF,0xF9,0xCF,0x70,0x87,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xFC,0x70,0xFC,0x98,0x80,0xB8,0x84,0xF8,0xFC,0xF8,0x84,0xF8,
-    0x80,0xF8,0xF8,0xFF,0xFC,0xFF,0xF8,0x7F,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x0E,0x00,0x13,0x00,0x17,0x00,0x1F,0x00,0x1F,0x00,
-    0x1F,0x00,0x1F,0x00,0x1F,0xE0,0x9F,0xF0,0x0F,0xE0,0x00,0x00,0x00,0x00
+// Things the event scheduler does once the machine reaches a given cycle.
+enum CHIP8_EVENTS
+{
+    CHIP8_EVENT_TIMERS = 0,                         // Decrement the delay and sound timers, 60 times a second.
+    CHIP8_EVENT_VBLANK = 1,                         // End of a 60Hz frame.
+    CHIP8_EVENT_KEYS = 2                            // Deliver a new keypad state.
 };
 
-#include "tigr.h"
+// Most events that can be waiting at once.
+#define CHIP8_MAX_EVENTS 16
+
+// Cycles per second new machines are paced for, 10 flat model instructions per 60Hz frame.
+#define CHIP8_DEFAULT_SPEED 600
+
+// Timing models, how many cycles each instruction takes.
+enum CHIP8_TIMINGS
+{
+    CHIP8_TIMING_FLAT = 0,                          // Every instruction takes one cycle, at the machine's chosen speed.
+    CHIP8_TIMING_VIP = 1,                           // COSMAC VIP machine cycles at its 1.76MHz clock.
+    CHIP8_TIMING_SCHIP = 2,                         // SuperChip on the HP48, relative to its ALU instructions.
+    CHIP8_TIMING_COUNT = 3
+};
+
+// Behaviours that differ between Chip8 interpreters. The cores are built once for each
+// profile, so they only test these while decoding or translating, never while running.
+#define CHIP8_QUIRK_SHIFTVY     0x01                // 8XY6 and 8XYE shift Vy into Vx, rather than shifting Vx.
+#define CHIP8_QUIRK_LOADSTORE   0x02                // FX55 and FX65 leave I past the last register, I += X + 1.
+#define CHIP8_QUIRK_LOADSTOREX  0x04                // FX55 and FX65 leave I on the last register, I += X.
+#define CHIP8_QUIRK_JUMPVX      0x08                // BXNN jumps to XNN + VX rather than NNN + V0.
+#define CHIP8_QUIRK_CLIP        0x10                // Sprites are cut off at the edges of the screen rather than wrapping.
+#define CHIP8_QUIRK_DISPLAYWAIT 0x20                // DXYN waits for the next frame, so at most 60 sprites are drawn a second.
+
+// Interpreters whose quirks a machine can follow.
+enum CHIP8_PROFILES
+{
+    CHIP8_PROFILE_DEFAULT = 0,                      // This emulator's own mix, SuperChip 1.1 apart from BNNN and wrapping sprites.
+    CHIP8_PROFILE_CHIP8 = 1,                        // The original COSMAC VIP interpreter.
+    CHIP8_PROFILE_SCHIP10 = 2,                      // SuperChip 1.0.
+    CHIP8_PROFILE_SCHIP11 = 3,                      // SuperChip 1.1.
+    CHIP8_PROFILE_XOCHIP = 4,                       // XO-CHIP, as Octo runs it.
+    CHIP8_PROFILE_COUNT = 5
+};
+
+// The quirks of each profile.
+#define CHIP8_QUIRKS_DEFAULT    0
+#define CHIP8_QUIRKS_CHIP8      (CHIP8_QUIRK_SHIFTVY | CHIP8_QUIRK_LOADSTORE | CHIP8_QUIRK_CLIP | CHIP8_QUIRK_DISPLAYWAIT)
+#define CHIP8_QUIRKS_SCHIP10    (CHIP8_QUIRK_LOADSTOREX | CHIP8_QUIRK_JUMPVX | CHIP8_QUIRK_CLIP)
+#define CHIP8_QUIRKS_SCHIP11    (CHIP8_QUIRK_JUMPVX | CHIP8_QUIRK_CLIP)
+#define CHIP8_QUIRKS_XOCHIP     (CHIP8_QUIRK_SHIFTVY | CHIP8_QUIRK_LOADSTORE)
+
+// An event waiting in the scheduler.
+typedef struct Chip8_Event
+{
+    uint64_t        Cycle;                          // Cycle the event happens at.
+    int             Type;                           // One of CHIP8_EVENTS.
+    unsigned short  Keys;                           // Keypad state for CHIP8_EVENT_KEYS.
+} Chip8_Event;
+
+// Core used by new machines, override with -DCHIP8_DEFAULT_CORE=CHIP8_CORE_THREADED.
+#ifndef CHIP8_DEFAULT_CORE
+#define CHIP8_DEFAULT_CORE CHIP8_CORE_DECODED
+#endif
+
+struct Chip8_Machine;
+struct Chip8_Instruction;
+
+// Function that executes one pre-decoded instruction.
+typedef void (*Chip8_OpHandler)(struct Chip8_Machine *chip8, const struct Chip8_Instruction *ins);
+
+// Function that executes a fused sequence of pre-decoded instructions, starting none once
+// cycles have been used, and returns the number of cycles used.
+typedef int (*Chip8_FusedHandler)(struct Chip8_Machine *chip8, const struct Chip8_Instruction *ins, int cycles);
+
+// Superinstructions, common instruction sequences the decoded core runs as one.
+enum CHIP8_FUSIONS
+{
+    CHIP8_FUSE_DRAWAT = 0,                          // 6XKK 6YKK DXYN - Load coordinates and draw.
+    CHIP8_FUSE_DRAWSPRITE = 1,                      // ANNN DXYN - Point I at a sprite and draw.
+    CHIP8_FUSE_COUNTLOOP = 2,                       // 7XKK 3XKK 1NNN - Counter loop.
+    CHIP8_FUSE_DELAYWAIT = 3,                       // FX07 3X00 1NNN - Wait for the delay timer.
+    CHIP8_FUSE_KEYWAIT = 4,                         // EX9E / EXA1 1NNN - Wait for a key, jumping back to the test.
+    CHIP8_FUSE_SELFJUMP = 5,                        // 1NNN - Jump to itself.
+    CHIP8_FUSE_COUNT = 6
+};
+
+// Longest fused sequence in instructions.
+#define CHIP8_FUSE_MAXLENGTH 3
+
+// A pre-decoded instruction, as held in the machine's decode cache.
+typedef struct Chip8_Instruction
+{
+    Chip8_OpHandler Handler;                        // Executes the instruction, NULL if not decoded yet.
+    unsigned short  OpCode;                         // The raw OpCode.
+    unsigned short  nnn;                            // Lowest 12 bits, an address.
+    unsigned char   x;                              // Lower 4 bits of the high byte, a register.
+    unsigned char   y;                              // Upper 4 bits of the low byte, a register.
+    unsigned char   n;                              // Lowest 4 bits.
+    unsigned char   kk;                             // Lowest 8 bits, a byte.
+    unsigned short  Cost;                           // Cycles the instruction takes under the machine's timing model.
+    unsigned short  Lead;                           // Cycles Fused takes before its last instruction starts.
+    Chip8_FusedHandler Fused;                       // Executes this and the following instructions, or one that can stop the run, else NULL.
+} Chip8_Instruction;
+
+// The complete state of one Chip8 Virtual Machine.
+typedef struct Chip8_Machine
+{
+    int Core;                                       // Interpreter core used by Chip8_EmulateCycles.
+    int Profile;                                    // One of CHIP8_PROFILES, takes effect when the next ROM is loaded.
+    int LoadedProfile;                              // The profile the loaded ROM runs with, set by Chip8_LoadROM.
+    int Quirks;                                     // CHIP8_QUIRK flags of LoadedProfile.
+    int RunState;                                   // One of CHIP8_RUNSTATES.
+    int Super;                                      // Flag which mode the Virtual Machine is in.
+    int ScreenWidth;                                // Current Screen Width.
+    int ScreenHeight;                               // Current Screen Height.
+
+    // Current OpCode.
+    unsigned short  OpCode;                         // Current OpCode.
+
+    // Pre-decoded instructions, indexed by address.
+    // Kept ahead of ProgramMemory so a stray guest write past the end can't reach the handler pointers.
+    Chip8_Instruction DecodeCache[4096];            // Filled as instructions are first executed.
+
+    // Translated code for CHIP8_CORE_JIT.
+    struct Chip8_Jit *Jit;                          // Created the first time the JIT core runs.
+
+    // Ahead of time compiled code for CHIP8_CORE_COMPILED.
+    const struct Chip8_CompiledROM *Compiled;       // Set by Chip8_LoadROM when the ROM was linked in.
+
+    // Program Memory, every guest address is masked to 12 bits before it is used.
+    unsigned char   ProgramMemory[4096];            // Chip 8's Main Memory.
+
+    // Display Memory, one bit per pixel with the leftmost pixel of each word in the top bit.
+    // Pixel (x, y) is bit x + y * ScreenWidth, so a row is one word in low res and two in high res.
+    uint64_t        DisplayMemory[128];             // Chip 8 Display 128 words = 8192 bits = (128 * 64)
+
+    // Various Registers.
+    unsigned char   VRegister[16];                  // Chip8's 16 Registers.
+    unsigned char   HP48Registers[16];              // Addition registers for SuperChip instructions.
+    unsigned short  IndexRegister;                  // Chip8's Index register.
+    unsigned short  ProgramCounter;                 // Program counter.
+
+    // Timers.
+    unsigned char   DelayTimer;                     // Delay Timer.
+    unsigned char   SoundTimer;                     // Sound Timer.
+
+    // Event scheduler, timed in machine cycles rather than host time.
+    uint64_t        Cycles;                         // Cycles run, or skipped, since the machine was reset.
+    int             CyclesPerSecond;                // Speed the 60Hz events are spaced for, kept across resets.
+    uint64_t        TickBase;                       // Cycle the 60Hz events are counted from.
+    uint64_t        TimerTicks;                     // Timer events since TickBase.
+    uint64_t        Frames;                         // VBlank events since TickBase.
+    int             VBlank;                         // Set when the last event run ended a frame.
+    Chip8_Event     Events[CHIP8_MAX_EVENTS];       // Waiting events, soonest first.
+    int             EventCount;                     // Number of waiting events.
+
+    // Timing model, kept across resets.
+    int             Timing;                         // One of CHIP8_TIMINGS.
+    const struct Chip8_TimingModel *TimingModel;    // The model's cycle costs.
+    const unsigned short *CycleCosts;               // Cycles each OpCode takes, indexed by OpCode.
+    int             StallCycles;                    // Cycles instructions took beyond CycleCosts, such as drawing, added after the core returns.
+
+    // Random numbers for CXKK, the same seed always gives the same sequence.
+    uint32_t        RandomSeed;                     // Seed the generator restarts from on reset, kept across resets.
+    uint32_t        RandomState;                    // Current xorshift state, never zero.
+
+    // Run control.
+    int             StopReason;                     // CHIP8_EXITS an instruction ended the core's run early with, or CHIP8_EXIT_BUDGET.
+    uint64_t        Breakpoints[64];                // One bit per address Chip8_Run stops before, kept across resets.
+    int             BreakpointCount;                // Number of bits set in Breakpoints.
+
+    // Chip8 Call Stack and Pointer.
+    unsigned short  Stack[16];                      // Chip8's stack.
+    unsigned short  StackPointer;                   // Stack pointer.
+
+    // Chip8 Key States.
+    unsigned char   KeyStates[16];                  // Store key states.
+
+    // Screen Update Flag.
+    unsigned char   DrawFlag;                       // Okay to redraw screen.
+    uint64_t        DirtyRows;                      // One bit per display row changed since the last draw.
+
+    // Renderer lookup table, the TPixels for each byte of display memory at the current pixel width.
+    TPixel          *PixelTable;                    // 256 runs of 8 * PixelTableWidth pixels.
+    int             PixelTableWidth;                // Bitmap pixels per Chip8 pixel the table was built for.
+    int             Filter;                         // CHIP8_FILTERS applied by Chip8_DrawScreen.
+
+    // Superinstruction statistics for the current ROM.
+    unsigned long   FusedSites[CHIP8_FUSE_COUNT];   // Sequences fused when decoded.
+    unsigned long   FusedInstructions[CHIP8_FUSE_COUNT]; // Instructions executed by fused sequences.
+    unsigned long   IdleInstructions;               // Instructions skipped in idle loops.
+
+    // Idle loop detection.
+    int             Idle;                           // Set when the last Chip8_EmulateCycles finished in an idle loop.
+} Chip8_Machine;
 
 // Function prototypes.
-int Chip8_LoadROM(char *ROM_FileName);
-void Chip8_Initialise(void);
-void Chip8_EmulateCPU(void);
-void Chip8_GetKeyStates(Tigr *screen);
-void Chip8_DrawScreen(Tigr *screen);
-void Chip8_ShowProgramState(void);
+Chip8_Machine *Chip8_Create(void);
+void Chip8_Destroy(Chip8_Machine *chip8);
+void Chip8_Initialise(Chip8_Machine *chip8);
+int Chip8_LoadROM(Chip8_Machine *chip8, char *ROM_FileName);
+void Chip8_EmulateCPU(Chip8_Machine *chip8);
+void Chip8_EmulateCycles(Chip8_Machine *chip8, int cycles);
+int Chip8_EmulateFrame(Chip8_Machine *chip8);
+int Chip8_Run(Chip8_Machine *chip8, int cycles, int stopOn);
+void Chip8_SetBreakpoint(Chip8_Machine *chip8, unsigned short address, int set);
+void Chip8_SetSpeed(Chip8_Machine *chip8, int cyclesPerSecond);
+void Chip8_SetTiming(Chip8_Machine *chip8, int timing);
+int Chip8_ScheduleKeys(Chip8_Machine *chip8, uint64_t cycle, unsigned short keys);
+void Chip8_SetSeed(Chip8_Machine *chip8, uint32_t seed);
+unsigned char Chip8_Random(Chip8_Machine *chip8);
+uint64_t Chip8_StateHash(Chip8_Machine *chip8);
+void Chip8_Step(Chip8_Machine *chip8);
+unsigned short Chip8_ReadKeys(Tigr *screen);
+void Chip8_SetKeyStates(Chip8_Machine *chip8, unsigned short keys);
+void Chip8_GetKeyStates(Chip8_Machine *chip8, Tigr *screen);
+int Chip8_DrawScreen(Chip8_Machine *chip8, Tigr *screen);
+int Chip8_DrawScreenFill(Chip8_Machine *chip8, Tigr *screen);
+int Chip8_GetPixel(Chip8_Machine *chip8, int x, int y);
+void Chip8_ShowProgramState(Chip8_Machine *chip8);
+void Chip8_ShowFusionStats(Chip8_Machine *chip8);
 void Chip8_ProcessDroppedFiles(void);
-void Chip8_Disassemble(void);
+void Chip8_Disassemble(Chip8_Machine *chip8);
 
 #endif
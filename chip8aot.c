@@ -0,0 +1,602 @@
+// MIT License
+//
+// Copyright (c) 2018 - 2022 Les Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+
+// chip8aot - Compiles Chip8 ROMs to C ahead of time.
+//
+// Usage: chip8aot [-profile name] output.c rom.ch8 [rom.ch8 ...]
+//
+// Every instruction reachable from 0x200 is translated to C, one function per
+// run of consecutive instructions. Build the emulator with the generated file
+// and -DCHIP8_AOT, and machines on CHIP8_CORE_COMPILED run any of these ROMs as
+// native code. Computed jumps (BNNN), code the analysis didn't find and
+// self-modifying code are left to the interpreter. The code follows the quirks
+// of one profile, default unless -profile picks another, and is only used by
+// machines that load the ROM with that profile.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+
+#define CHIP8_AOT_MAXREGION 256 // Most instructions compiled into a single function.
+
+// The profiles ROMs can be compiled for, in the order of CHIP8_PROFILES.
+typedef struct Chip8_AotProfile
+{
+  const char *Name;             // Name given to -profile, as the emulator takes it.
+  const char *Symbol;           // The CHIP8_PROFILES constant written to the generated file.
+  int Quirks;                   // CHIP8_QUIRK flags the code follows.
+} Chip8_AotProfile;
+
+static const Chip8_AotProfile Chip8_AotProfiles[CHIP8_PROFILE_COUNT] = {
+    {"default", "CHIP8_PROFILE_DEFAULT", CHIP8_QUIRKS_DEFAULT},
+    {"chip8", "CHIP8_PROFILE_CHIP8", CHIP8_QUIRKS_CHIP8},
+    {"schip10", "CHIP8_PROFILE_SCHIP10", CHIP8_QUIRKS_SCHIP10},
+    {"schip11", "CHIP8_PROFILE_SCHIP11", CHIP8_QUIRKS_SCHIP11},
+    {"xochip", "CHIP8_PROFILE_XOCHIP", CHIP8_QUIRKS_XOCHIP}};
+
+// A ROM being compiled.
+typedef struct Chip8_AotROM
+{
+  const char *FileName;
+  unsigned char Memory[4096];   // Program memory as the emulator loads it.
+  int Size;                     // ROM size in bytes.
+  unsigned char Reachable[4096]; // Set for each address that can be executed.
+  int Region[4096];             // Start of the region holding each compiled address, or -1.
+  int Profile;                  // One of CHIP8_PROFILES, the quirks to compile for.
+} Chip8_AotROM;
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_AotLoadROM
+ * Loads a ROM file the same way Chip8_LoadROM does.
+ *
+ * Parameters:
+ * Chip8_AotROM *rom - Receives the ROM.
+ * const char *FileName - Path to the ROM file.
+ * int profile - One of CHIP8_PROFILES, the quirks to compile for.
+ *
+ * Returns:
+ * int - EXIT_SUCCESS or EXIT_FAILURE.
+ */
+static int Chip8_AotLoadROM(Chip8_AotROM *rom, const char *FileName, int profile)
+{
+  FILE *fp = fopen(FileName, "rb");
+  if (fp == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+
+  memset(rom, 0, sizeof(Chip8_AotROM));
+  rom->FileName = FileName;
+  rom->Profile = profile;
+  rom->Size = (int)fread(&rom->Memory[0x200], 1, 4096 - 0x200, fp);
+  fclose(fp);
+
+  for (int i = 0; i < 4096; i++)
+  {
+    rom->Region[i] = -1;
+  }
+  return EXIT_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+
+// Returns 1 if both bytes of the instruction at address come from the ROM.
+static int Chip8_AotInImage(const Chip8_AotROM *rom, int address)
+{
+  return address >= 0x200 && address + 2 <= 0x200 + rom->Size;
+}
+
+// Returns the OpCode at address.
+static unsigned short Chip8_AotOpCode(const Chip8_AotROM *rom, int address)
+{
+  return (rom->Memory[address] << 8) + rom->Memory[address + 1];
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_AotSuccessors
+ * Lists the addresses that can run after an instruction.
+ *
+ * Parameters:
+ * unsigned short OpCode - The instruction.
+ * int address - Address of the instruction.
+ * int *next - Receives up to two addresses.
+ *
+ * Returns:
+ * int - The number of addresses in next.
+ */
+static int Chip8_AotSuccessors(unsigned short OpCode, int address, int *next)
+{
+  int nnn = OpCode & 0x0FFF;
+
+  switch (OpCode & 0xF000)
+  {
+  case 0x0000:
+    // Returns are followed from their calls, exits restart the machine.
+    if (OpCode == 0x00EE || OpCode == 0x00FD)
+    {
+      return 0;
+    }
+    if ((OpCode & 0xFFF0) == 0x00C0 || OpCode == 0x00E0 || OpCode == 0x00FB ||
+        OpCode == 0x00FC || OpCode == 0x00FE || OpCode == 0x00FF)
+    {
+      next[0] = address + 2;
+      return 1;
+    }
+    return 0;
+
+  case 0x1000:
+    next[0] = nnn;
+    return 1;
+
+  // Calls continue at the target and again once the subroutine returns.
+  case 0x2000:
+    next[0] = nnn;
+    next[1] = address + 2;
+    return 2;
+
+  case 0x3000:
+  case 0x4000:
+  case 0x5000:
+  case 0x9000:
+    next[0] = address + 2;
+    next[1] = address + 4;
+    return 2;
+
+  // The target of a computed jump isn't known until it runs.
+  case 0xB000:
+    return 0;
+
+  case 0xE000:
+    if ((OpCode & 0x00FF) == 0x009E || (OpCode & 0x00FF) == 0x00A1)
+    {
+      next[0] = address + 2;
+      next[1] = address + 4;
+      return 2;
+    }
+    return 0;
+  }
+
+  next[0] = address + 2;
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_AotFindCode
+ * Marks every instruction reachable from 0x200, then groups them into regions
+ * of consecutive instructions which are each compiled into one function.
+ *
+ * Parameters:
+ * Chip8_AotROM *rom - The ROM to analyse.
+ *
+ * Returns:
+ * int - The number of regions.
+ */
+static int Chip8_AotFindCode(Chip8_AotROM *rom)
+{
+  static int Pending[4096];
+  int count = 0;
+  int regions = 0;
+
+  if (Chip8_AotInImage(rom, 0x200))
+  {
+    Pending[count++] = 0x200;
+    rom->Reachable[0x200] = 1;
+  }
+
+  while (count > 0)
+  {
+    int address = Pending[--count];
+    int next[2];
+    int n = Chip8_AotSuccessors(Chip8_AotOpCode(rom, address), address, next);
+
+    for (int i = 0; i < n; i++)
+    {
+      if (Chip8_AotInImage(rom, next[i]) && !rom->Reachable[next[i]])
+      {
+        rom->Reachable[next[i]] = 1;
+        Pending[count++] = next[i];
+      }
+    }
+  }
+
+  for (int start = 0x200; start < 4096; start++)
+  {
+    if (!rom->Reachable[start] || rom->Region[start] >= 0)
+    {
+      continue;
+    }
+
+    for (int address = start, length = 0;
+         address < 4096 && rom->Reachable[address] && rom->Region[address] < 0 && length < CHIP8_AOT_MAXREGION;
+         address += 2, length++)
+    {
+      rom->Region[address] = start;
+    }
+    regions++;
+  }
+  return regions;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_AotEmitJump
+ * Continues at target, directly if it's in the same region.
+ *
+ * Parameters:
+ * FILE *out - The generated file.
+ * const Chip8_AotROM *rom - The ROM being compiled.
+ * int start - Start of the current region.
+ * int target - Address to continue at.
+ *
+ * Returns:
+ * void.
+ */
+static void Chip8_AotEmitJump(FILE *out, const Chip8_AotROM *rom, int start, int target)
+{
+  target &= 0xFFFF;
+  if (target < 4096 && rom->Region[target] == start)
+  {
+    fprintf(out, "goto Address_0x%03X;\n", target);
+  }
+  else
+  {
+    fprintf(out, "CHIP8_AOT_EXIT(0x%03X)\n", target);
+  }
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_AotEmitInstruction
+ * Writes the C for one instruction, matching the interpreter's handler for
+ * the ROM's profile.
+ *
+ * Parameters:
+ * FILE *out - The generated file.
+ * const Chip8_AotROM *rom - The ROM being compiled.
+ * int start - Start of the current region.
+ * int address - Address of the instruction.
+ *
+ * Returns:
+ * void.
+ */
+static void Chip8_AotEmitInstruction(FILE *out, const Chip8_AotROM *rom, int start, int address)
+{
+  unsigned short OpCode = Chip8_AotOpCode(rom, address);
+  int x = (OpCode & 0x0F00) >> 8;
+  int y = (OpCode & 0x00F0) >> 4;
+  int kk = OpCode & 0x00FF;
+  int nnn = OpCode & 0x0FFF;
+  int quirks = Chip8_AotProfiles[rom->Profile].Quirks;
+  int skip = 0;
+  int interpret = 0;
+
+  fprintf(out, "  CHIP8_AOT_STEP(0x%03X, 0x%04X)\n", address, OpCode);
+
+  switch (OpCode & 0xF000)
+  {
+  case 0x0000:
+    if (OpCode != 0x00EE)
+    {
+      interpret = 1;
+      break;
+    }
+    fprintf(out, "    chip8->StackPointer = (chip8->StackPointer - 1) & 0xF;\n");
+    fprintf(out, "    chip8->ProgramCounter = chip8->Stack[chip8->StackPointer];\n");
+    fprintf(out, "    chip8->ProgramCounter += 2;\n");
+    fprintf(out, "    return n;\n");
+    return;
+
+  case 0x1000:
+    fprintf(out, "    ");
+    Chip8_AotEmitJump(out, rom, start, nnn);
+    return;
+
+  case 0x2000:
+    fprintf(out, "    chip8->Stack[chip8->StackPointer] = 0x%03X;\n", address);
+    fprintf(out, "    chip8->StackPointer = (chip8->StackPointer + 1) & 0xF;\n");
+    fprintf(out, "    ");
+    Chip8_AotEmitJump(out, rom, start, nnn);
+    return;
+
+  case 0x3000: fprintf(out, "    if (V[0x%X] == 0x%02X)\n", x, kk); skip = 1; break;
+  case 0x4000: fprintf(out, "    if (V[0x%X] != 0x%02X)\n", x, kk); skip = 1; break;
+  case 0x5000: fprintf(out, "    if (V[0x%X] == V[0x%X])\n", x, y); skip = 1; break;
+  case 0x9000: fprintf(out, "    if (V[0x%X] != V[0x%X])\n", x, y); skip = 1; break;
+
+  case 0x6000: fprintf(out, "    V[0x%X] = 0x%02X;\n", x, kk); break;
+  case 0x7000: fprintf(out, "    V[0x%X] += 0x%02X;\n", x, kk); break;
+
+  case 0x8000:
+    switch (OpCode & 0x000F)
+    {
+    case 0x0000: fprintf(out, "    V[0x%X] = V[0x%X];\n", x, y); break;
+    case 0x0001: fprintf(out, "    V[0x%X] |= V[0x%X];\n", x, y); break;
+    case 0x0002: fprintf(out, "    V[0x%X] &= V[0x%X];\n", x, y); break;
+    case 0x0003: fprintf(out, "    V[0x%X] ^= V[0x%X];\n", x, y); break;
+    case 0x0004:
+      fprintf(out, "    V[0xF] = V[0x%X] > (255 - V[0x%X]);\n", y, x);
+      fprintf(out, "    V[0x%X] += V[0x%X];\n", x, y);
+      break;
+    case 0x0005:
+      fprintf(out, "    V[0xF] = V[0x%X] >= V[0x%X];\n", x, y);
+      fprintf(out, "    V[0x%X] -= V[0x%X];\n", x, y);
+      break;
+    case 0x0006:
+      if (quirks & CHIP8_QUIRK_SHIFTVY)
+      {
+        fprintf(out, "    V[0x%X] = V[0x%X];\n", x, y);
+      }
+      fprintf(out, "    V[0xF] = V[0x%X] & 0x1;\n", x);
+      fprintf(out, "    V[0x%X] = V[0x%X] / 2;\n", x, x);
+      break;
+    case 0x0007:
+      fprintf(out, "    V[0xF] = V[0x%X] >= V[0x%X];\n", y, x);
+      fprintf(out, "    V[0x%X] = V[0x%X] - V[0x%X];\n", x, y, x);
+      break;
+    case 0x000E:
+      if (quirks & CHIP8_QUIRK_SHIFTVY)
+      {
+        fprintf(out, "    V[0x%X] = V[0x%X];\n", x, y);
+      }
+      fprintf(out, "    V[0xF] = V[0x%X] >> 7;\n", x);
+      fprintf(out, "    V[0x%X] = V[0x%X] * 2;\n", x, x);
+      break;
+    default:
+      interpret = 1;
+      break;
+    }
+    break;
+
+  case 0xA000: fprintf(out, "    chip8->IndexRegister = 0x%03X;\n", nnn); break;
+
+  case 0xB000:
+    fprintf(out, "    chip8->ProgramCounter = 0x%03X + V[0x%X];\n", nnn, (quirks & CHIP8_QUIRK_JUMPVX) ? x : 0);
+    fprintf(out, "    return n;\n");
+    return;
+
+  case 0xC000: fprintf(out, "    V[0x%X] = Chip8_Random(chip8) & 0x%02X;\n", x, kk); break;
+
+  case 0xF000:
+    switch (OpCode & 0x00FF)
+    {
+    case 0x0007: fprintf(out, "    V[0x%X] = chip8->DelayTimer;\n", x); break;
+    case 0x0015: fprintf(out, "    chip8->DelayTimer = V[0x%X];\n", x); break;
+    case 0x0018: fprintf(out, "    chip8->SoundTimer = V[0x%X];\n", x); break;
+    case 0x001E:
+      fprintf(out, "    V[0xF] = 0;\n");
+      fprintf(out, "    V[0xF] = chip8->IndexRegister + V[0x%X] >= 0xFFF;\n", x);
+      fprintf(out, "    chip8->IndexRegister += V[0x%X];\n", x);
+      break;
+    case 0x0029: fprintf(out, "    chip8->IndexRegister = V[0x%X] * 0x5;\n", x); break;
+    case 0x0030: fprintf(out, "    chip8->IndexRegister = 80 + (V[0x%X] * 10);\n", x); break;
+    default:
+      interpret = 1;
+      break;
+    }
+    break;
+
+  // Drawing and keys.
+  default:
+    interpret = 1;
+    break;
+  }
+
+  if (interpret)
+  {
+    fprintf(out, "    CHIP8_AOT_INTERPRET(0x%03X)\n", address);
+
+    // A sprite that waits for the frame has stopped the run, leave for the core to see.
+    if ((quirks & CHIP8_QUIRK_DISPLAYWAIT) && (OpCode & 0xF000) == 0xD000)
+    {
+      fprintf(out, "    CHIP8_AOT_EXIT(0x%03X)\n", (address + 2) & 0xFFFF);
+      return;
+    }
+  }
+
+  // Skips continue two instructions on when their condition holds.
+  if (skip)
+  {
+    fprintf(out, "      ");
+    Chip8_AotEmitJump(out, rom, start, address + 4);
+  }
+
+  // Carry on with the next instruction, which may be in another region.
+  if (address + 2 >= 4096 || rom->Region[address + 2] != start)
+  {
+    fprintf(out, "    CHIP8_AOT_EXIT(0x%03X)\n", (address + 2) & 0xFFFF);
+  }
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_AotEmitROM
+ * Writes the compiled regions, block table and image for one ROM.
+ *
+ * Parameters:
+ * FILE *out - The generated file.
+ * const Chip8_AotROM *rom - The ROM to compile.
+ * int index - Number of the ROM in the output, used to name its symbols.
+ *
+ * Returns:
+ * void.
+ */
+static void Chip8_AotEmitROM(FILE *out, const Chip8_AotROM *rom, int index)
+{
+  fprintf(out, "//------------------------------------------------------------------------------\n\n");
+  fprintf(out, "// %s\n\n", rom->FileName);
+
+  // One function per region.
+  for (int start = 0x200; start < 4096; start++)
+  {
+    if (rom->Region[start] != start)
+    {
+      continue;
+    }
+
+    fprintf(out, "static int Chip8_ROM%d_Region%03X(Chip8_Machine *chip8, int cycles)\n{\n", index, start);
+    fprintf(out, "  unsigned char *V = chip8->VRegister;\n");
+    fprintf(out, "  int n = 0;\n\n");
+    fprintf(out, "  switch (chip8->ProgramCounter)\n  {\n");
+    fprintf(out, "  default:\n    return 0;\n\n");
+    for (int address = start; address < 4096 && rom->Region[address] == start; address += 2)
+    {
+      Chip8_AotEmitInstruction(out, rom, start, address);
+      fprintf(out, "\n");
+    }
+    fprintf(out, "  }\n  return n;\n}\n\n");
+  }
+
+  // The region each compiled instruction is in.
+  fprintf(out, "static const Chip8_CompiledBlock Chip8_ROM%d_Blocks[4096] =\n{\n", index);
+  for (int address = 0x200; address < 4096; address++)
+  {
+    if (rom->Region[address] >= 0)
+    {
+      fprintf(out, "  [0x%03X] = Chip8_ROM%d_Region%03X,\n", address, index, rom->Region[address]);
+    }
+  }
+  fprintf(out, "};\n\n");
+
+  // The ROM itself, compared against what the emulator loads.
+  fprintf(out, "static const unsigned char Chip8_ROM%d_Image[%d] =\n{", index, rom->Size > 0 ? rom->Size : 1);
+  for (int i = 0; i < rom->Size; i++)
+  {
+    fprintf(out, "%s0x%02X,", (i % 12) ? " " : "\n  ", rom->Memory[0x200 + i]);
+  }
+  fprintf(out, "\n};\n\n");
+
+  fprintf(out, "static const Chip8_CompiledROM Chip8_ROM%d =\n{\n", index);
+  fprintf(out, "  \"");
+  for (const char *ch = rom->FileName; *ch; ch++)
+  {
+    if (*ch == '\\' || *ch == '"')
+    {
+      fputc('\\', out);
+    }
+    fputc(*ch, out);
+  }
+  fprintf(out, "\",\n  Chip8_ROM%d_Image,\n  %d,\n  Chip8_ROM%d_Blocks,\n  %s\n};\n\n", index, rom->Size, index,
+          Chip8_AotProfiles[rom->Profile].Symbol);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: main
+ * Main entry point for the compiler.
+ *
+ * Parameters:
+ * int argc     - Number of command line parameters
+ * char *argv[] - Optionally -profile and its name, then the output file followed by the ROM files to compile.
+ *
+ * Returns:
+ * int.
+ */
+int main(int argc, char *argv[])
+{
+  static Chip8_AotROM rom;
+  FILE *out;
+  int profile = CHIP8_PROFILE_DEFAULT;
+  int first = 1;
+
+  if (argc > 2 && strcmp(argv[1], "-profile") == 0)
+  {
+    for (profile = 0; profile < CHIP8_PROFILE_COUNT; profile++)
+    {
+      if (strcmp(argv[2], Chip8_AotProfiles[profile].Name) == 0)
+      {
+        break;
+      }
+    }
+    if (profile == CHIP8_PROFILE_COUNT)
+    {
+      fprintf(stderr, "Unknown profile %s\n", argv[2]);
+      return EXIT_FAILURE;
+    }
+    first = 3;
+  }
+
+  if (argc < first + 2)
+  {
+    fprintf(stderr, "Usage: %s [-profile default|chip8|schip10|schip11|xochip] output.c rom.ch8 [rom.ch8 ...]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  out = fopen(argv[first], "w");
+  if (out == NULL)
+  {
+    fprintf(stderr, "Unable to create %s\n", argv[first]);
+    return EXIT_FAILURE;
+  }
+
+  fprintf(out, "// Generated by chip8aot, do not edit.\n");
+  fprintf(out, "// Build with -DCHIP8_AOT and run with -core compiled.\n\n");
+  fprintf(out, "#include <stdlib.h>\n\n");
+  fprintf(out, "#include \"chip8aot.h\"\n\n");
+  fprintf(out, "// Most addresses are never the target of a goto, and Vx, Vx comparisons are left as written.\n");
+  fprintf(out, "#ifdef __GNUC__\n#pragma GCC diagnostic ignored \"-Wunused-label\"\n");
+  fprintf(out, "#pragma GCC diagnostic ignored \"-Wtautological-compare\"\n#endif\n\n");
+
+  for (int i = first + 1; i < argc; i++)
+  {
+    if (Chip8_AotLoadROM(&rom, argv[i], profile) != EXIT_SUCCESS)
+    {
+      fprintf(stderr, "Unable to open %s\n", argv[i]);
+      fclose(out);
+      return EXIT_FAILURE;
+    }
+
+    int regions = Chip8_AotFindCode(&rom);
+    int instructions = 0;
+    for (int address = 0; address < 4096; address++)
+    {
+      instructions += rom.Region[address] >= 0;
+    }
+
+    Chip8_AotEmitROM(out, &rom, i - first - 1);
+    printf("%s: %d instructions in %d regions\n", argv[i], instructions, regions);
+  }
+
+  // The list Chip8_LoadROM searches.
+  fprintf(out, "//------------------------------------------------------------------------------\n\n");
+  fprintf(out, "const Chip8_CompiledROM *const Chip8_CompiledROMs[] =\n{\n");
+  for (int i = first + 1; i < argc; i++)
+  {
+    fprintf(out, "  &Chip8_ROM%d,\n", i - first - 1);
+  }
+  fprintf(out, "  NULL\n};\n");
+
+  fclose(out);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+// MIT License
+//
+// Copyright (c) 2018 - 2022 Les Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+
+
+#ifndef CHIP8AOT_HEADER
+#define CHIP8AOT_HEADER
+
+#include "chip8.h"
+
+// A compiled region of a ROM, entered at the address in the program counter.
+// Runs for the cycles given and returns the number it used, or 0 if the
+// program counter isn't in the region.
+typedef int (*Chip8_CompiledBlock)(Chip8_Machine *chip8, int cycles);
+
+// A ROM translated to C by the chip8aot tool.
+typedef struct Chip8_CompiledROM
+{
+    const char *Name;                               // File name the ROM was compiled from.
+    const unsigned char *Image;                     // ROM contents, matched against loaded ROMs.
+    int Size;                                       // Size of Image in bytes.
+    const Chip8_CompiledBlock *Blocks;              // 4096 entries, the region holding each compiled instruction.
+    int Profile;                                    // One of CHIP8_PROFILES, the quirks the code follows.
+} Chip8_CompiledROM;
+
+// NULL terminated list of the ROMs linked into the build, defined by the generated file.
+extern const Chip8_CompiledROM *const Chip8_CompiledROMs[];
+
+// Helpers used by the generated code.
+
+// Start of the instruction at address, stops once the cycles have been used.
+#define CHIP8_AOT_STEP(address, opcode)       \
+  case address:                               \
+  Address_##address:                          \
+    if (n >= cycles)                          \
+    {                                         \
+      chip8->ProgramCounter = address;        \
+      return n;                               \
+    }                                         \
+    chip8->OpCode = opcode;                   \
+    n += chip8->CycleCosts[opcode];
+
+// Leave the region, continuing at address.
+#define CHIP8_AOT_EXIT(address)               \
+  {                                           \
+    chip8->ProgramCounter = address;          \
+    return n;                                 \
+  }
+
+// Hand the instruction at address to the interpreter, leaving the region if
+// it didn't just move on to the next instruction or the ROM was modified.
+#define CHIP8_AOT_INTERPRET(address)                                                     \
+  chip8->ProgramCounter = address;                                                       \
+  Chip8_Step(chip8);                                                                     \
+  if (chip8->ProgramCounter != (unsigned short)(address + 2) || chip8->Compiled == NULL) \
+  {                                                                                      \
+    return n;                                                                            \
+  }
+
+#endif
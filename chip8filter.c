@@ -0,0 +1,205 @@
+// MIT License
+//
+// Copyright (c) 2018 - 2022 Les Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+
+#include <string.h>
+
+#include "chip8filter.h"
+
+// The display only has two colours, so every pixel is a bit and the Scale2x and
+// Scale3x rules can be worked out for a whole row of display memory at once with
+// bitwise operations. Pixels off the edge of the display take the value of the
+// nearest pixel on it.
+//
+// Neighbours of pixel E, as named by the Scale2x / Scale3x rules:
+//
+//   A B C
+//   D E F
+//   G H I
+
+// A row of pixels, one or two words depending on the resolution.
+typedef struct Chip8_FilterBits
+{
+  uint64_t Word[2];
+} Chip8_FilterBits;
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_FilterScale
+ * Gets how many times larger a filter makes the display.
+ *
+ * Parameters:
+ * int filter - One of CHIP8_FILTERS.
+ *
+ * Returns:
+ * int - The scale, 1 for CHIP8_FILTER_NONE.
+ */
+int Chip8_FilterScale(int filter)
+{
+  switch (filter)
+  {
+  case CHIP8_FILTER_SCALE2X:
+    return 2;
+
+  case CHIP8_FILTER_SCALE3X:
+    return 3;
+
+  default:
+    return 1;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+// Loads a display row, clamped to the top and bottom of the display.
+static Chip8_FilterBits Chip8_FilterLoad(Chip8_Machine *chip8, int words, int row)
+{
+  Chip8_FilterBits Bits = {{0, 0}};
+
+  row = (row < 0) ? 0 : (row >= chip8->ScreenHeight) ? chip8->ScreenHeight - 1 : row;
+  for (int w = 0; w < words; w++)
+  {
+    Bits.Word[w] = chip8->DisplayMemory[row * words + w];
+  }
+  return Bits;
+}
+
+// Each pixel's left hand neighbour, pixel 0 keeps its own value.
+static Chip8_FilterBits Chip8_FilterLeft(Chip8_FilterBits p, int words)
+{
+  Chip8_FilterBits Bits = {{0, 0}};
+
+  for (int w = 0; w < words; w++)
+  {
+    uint64_t Carry = (w > 0) ? p.Word[w - 1] << 63 : p.Word[0] & ((uint64_t)1 << 63);
+    Bits.Word[w] = (p.Word[w] >> 1) | Carry;
+  }
+  return Bits;
+}
+
+// Each pixel's right hand neighbour, the last pixel keeps its own value.
+static Chip8_FilterBits Chip8_FilterRight(Chip8_FilterBits p, int words)
+{
+  Chip8_FilterBits Bits = {{0, 0}};
+
+  for (int w = 0; w < words; w++)
+  {
+    uint64_t Carry = (w + 1 < words) ? p.Word[w + 1] >> 63 : p.Word[w] & 1;
+    Bits.Word[w] = (p.Word[w] << 1) | Carry;
+  }
+  return Bits;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_FilterRow
+ * Runs a filter over one row of the display.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine whose display is filtered.
+ * int filter - One of CHIP8_FILTERS.
+ * int row - The display row to filter.
+ * Chip8_FilteredRow *out - Receives Scale x Scale rows of bits for the row.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_FilterRow(Chip8_Machine *chip8, int filter, int row, Chip8_FilteredRow *out)
+{
+  int words = chip8->ScreenWidth / 64;
+
+  // Unfiltered, the row is passed straight through.
+  if (filter != CHIP8_FILTER_SCALE2X && filter != CHIP8_FILTER_SCALE3X)
+  {
+    for (int w = 0; w < words; w++)
+    {
+      out->Rows[0][0][w] = chip8->DisplayMemory[row * words + w];
+    }
+    return;
+  }
+
+  Chip8_FilterBits Up = Chip8_FilterLoad(chip8, words, row - 1);
+  Chip8_FilterBits Middle = Chip8_FilterLoad(chip8, words, row);
+  Chip8_FilterBits Down = Chip8_FilterLoad(chip8, words, row + 1);
+  Chip8_FilterBits UpLeft = Chip8_FilterLeft(Up, words);
+  Chip8_FilterBits UpRight = Chip8_FilterRight(Up, words);
+  Chip8_FilterBits Left = Chip8_FilterLeft(Middle, words);
+  Chip8_FilterBits Right = Chip8_FilterRight(Middle, words);
+  Chip8_FilterBits DownLeft = Chip8_FilterLeft(Down, words);
+  Chip8_FilterBits DownRight = Chip8_FilterRight(Down, words);
+
+  memset(out, 0, sizeof(Chip8_FilteredRow));
+
+  for (int w = 0; w < words; w++)
+  {
+    uint64_t A = UpLeft.Word[w], B = Up.Word[w], C = UpRight.Word[w];
+    uint64_t D = Left.Word[w], E = Middle.Word[w], F = Right.Word[w];
+    uint64_t G = DownLeft.Word[w], H = Down.Word[w], I = DownRight.Word[w];
+
+    switch (filter)
+    {
+    case CHIP8_FILTER_SCALE2X:
+    {
+      // E0 = D == B && B != F && D != H ? D : E, and the same turned for each corner.
+      uint64_t TopLeft = ~(D ^ B) & (B ^ F) & (D ^ H);
+      uint64_t TopRight = ~(B ^ F) & (B ^ D) & (F ^ H);
+      uint64_t BottomLeft = ~(D ^ H) & (D ^ B) & (H ^ F);
+      uint64_t BottomRight = ~(H ^ F) & (H ^ D) & (F ^ B);
+
+      out->Rows[0][0][w] = (TopLeft & D) | (~TopLeft & E);
+      out->Rows[0][1][w] = (TopRight & F) | (~TopRight & E);
+      out->Rows[1][0][w] = (BottomLeft & D) | (~BottomLeft & E);
+      out->Rows[1][1][w] = (BottomRight & F) | (~BottomRight & E);
+      break;
+    }
+
+    case CHIP8_FILTER_SCALE3X:
+    {
+      // The corner tests, as for Scale2x.
+      uint64_t TopLeft = ~(D ^ B) & (B ^ F) & (D ^ H);
+      uint64_t TopRight = ~(B ^ F) & (B ^ D) & (F ^ H);
+      uint64_t BottomLeft = ~(D ^ H) & (D ^ B) & (H ^ F);
+      uint64_t BottomRight = ~(H ^ F) & (H ^ D) & (F ^ B);
+
+      // The edges take a corner's colour when the pixel next to it along the edge differs from E.
+      uint64_t Top = (TopLeft & (E ^ C)) | (TopRight & (E ^ A));
+      uint64_t MiddleLeft = (TopLeft & (E ^ G)) | (BottomLeft & (E ^ A));
+      uint64_t MiddleRight = (TopRight & (E ^ I)) | (BottomRight & (E ^ C));
+      uint64_t Bottom = (BottomLeft & (E ^ I)) | (BottomRight & (E ^ G));
+
+      out->Rows[0][0][w] = (TopLeft & D) | (~TopLeft & E);
+      out->Rows[0][1][w] = (Top & B) | (~Top & E);
+      out->Rows[0][2][w] = (TopRight & F) | (~TopRight & E);
+      out->Rows[1][0][w] = (MiddleLeft & D) | (~MiddleLeft & E);
+      out->Rows[1][1][w] = E;
+      out->Rows[1][2][w] = (MiddleRight & F) | (~MiddleRight & E);
+      out->Rows[2][0][w] = (BottomLeft & D) | (~BottomLeft & E);
+      out->Rows[2][1][w] = (Bottom & H) | (~Bottom & E);
+      out->Rows[2][2][w] = (BottomRight & F) | (~BottomRight & E);
+      break;
+    }
+
+    }
+  }
+}
@@ -0,0 +1,43 @@
+// MIT License
+//
+// Copyright (c) 2018 - 2022 Les Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+
+#ifndef CHIP8FILTER_HEADER
+#define CHIP8FILTER_HEADER
+
+#include "chip8.h"
+
+#define CHIP8_FILTER_MAXSCALE 3     // Largest scale any filter produces.
+
+// A filtered display row, Rows[subrow][subcolumn] holds one bit per Chip8 pixel,
+// laid out like a row of display memory. Pixel x of the row becomes the block
+// of subrows and subcolumns at (x * Scale, row * Scale) in the filtered image.
+typedef struct Chip8_FilteredRow
+{
+    uint64_t        Rows[CHIP8_FILTER_MAXSCALE][CHIP8_FILTER_MAXSCALE][2];
+} Chip8_FilteredRow;
+
+// Function prototypes.
+int Chip8_FilterScale(int filter);
+void Chip8_FilterRow(Chip8_Machine *chip8, int filter, int row, Chip8_FilteredRow *out);
+
+#endif
@@ -0,0 +1,855 @@
+// MIT License
+//
+// Copyright (c) 2018 - 2022 Les Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8jit.h"
+
+#ifdef CHIP8_JIT_AVAILABLE
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define CHIP8_JIT_CODESIZE (256 * 1024) // Bytes of executable memory per machine.
+#define CHIP8_JIT_MAXCODE 4096          // Most host code a single block can need.
+#define CHIP8_JIT_MAXBLOCK 64           // Longest block in Chip8 instructions.
+
+// Translation states for each address.
+enum CHIP8_JIT_STATES
+{
+  CHIP8_JIT_UNTRANSLATED = 0,
+  CHIP8_JIT_TRANSLATED = 1,
+  CHIP8_JIT_UNSUPPORTED = 2
+};
+
+// x86-64 register numbers.
+enum CHIP8_JIT_REGISTERS
+{
+  RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+  R8 = 8, R9 = 9, R10 = 10, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15
+};
+
+// Host registers the Chip8 V registers are held in while a block runs.
+// RBX holds the machine pointer, RAX, RCX and RDX are scratch.
+static const int Chip8_JitPool[] = {R8, R9, R10, R11, R12, R13, R14, R15, RSI, RDI};
+#define CHIP8_JIT_POOLSIZE ((int)(sizeof(Chip8_JitPool) / sizeof(Chip8_JitPool[0])))
+
+// Condition codes used with SETcc and CMOVcc.
+#define CHIP8_JIT_CC_C 0x2  // Carry / below.
+#define CHIP8_JIT_CC_NC 0x3 // No carry / above or equal.
+#define CHIP8_JIT_CC_E 0x4  // Equal.
+#define CHIP8_JIT_CC_NE 0x5 // Not equal.
+
+// Translation state for one machine.
+struct Chip8_Jit
+{
+  unsigned char *Code;         // Memory holding the translated blocks, only writable while a block is emitted.
+  int CodeUsed;                // Bytes of Code in use.
+  Chip8_JitBlock Blocks[4096]; // Translated block starting at each address.
+  unsigned short Cycles[4096]; // Cycles taken by each block.
+  unsigned char State[4096];   // CHIP8_JIT_STATES for each address.
+  unsigned char Covered[4096]; // Set for every byte of program memory inside a block.
+};
+
+// Host code being written for a block.
+typedef struct Chip8_JitEmitter
+{
+  unsigned char *Code;
+  int Size;
+} Chip8_JitEmitter;
+
+//------------------------------------------------------------------------------
+
+static void Emit8(Chip8_JitEmitter *e, int value)
+{
+  e->Code[e->Size++] = (unsigned char)value;
+}
+
+static void Emit16(Chip8_JitEmitter *e, int value)
+{
+  Emit8(e, value & 0xFF);
+  Emit8(e, (value >> 8) & 0xFF);
+}
+
+static void Emit32(Chip8_JitEmitter *e, int value)
+{
+  Emit16(e, value & 0xFFFF);
+  Emit16(e, (value >> 16) & 0xFFFF);
+}
+
+// REX prefix, always emitted so SIL / DIL are used rather than DH / BH.
+static void EmitRex(Chip8_JitEmitter *e, int w, int reg, int rm)
+{
+  Emit8(e, 0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3));
+}
+
+// ModRM byte for a register to register operation.
+static void EmitModRM(Chip8_JitEmitter *e, int reg, int rm)
+{
+  Emit8(e, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// ModRM byte and displacement for a [RBX + disp32] memory operand.
+static void EmitModRMMachine(Chip8_JitEmitter *e, int reg, int disp)
+{
+  Emit8(e, 0x80 | ((reg & 7) << 3) | RBX);
+  Emit32(e, disp);
+}
+
+// MOV r8, imm8
+static void EmitMovImm8(Chip8_JitEmitter *e, int reg, int value)
+{
+  EmitRex(e, 0, 0, reg);
+  Emit8(e, 0xB0 + (reg & 7));
+  Emit8(e, value);
+}
+
+// ADD / CMP r8, imm8 (ext is the ModRM opcode extension).
+static void EmitAluImm8(Chip8_JitEmitter *e, int ext, int reg, int value)
+{
+  EmitRex(e, 0, 0, reg);
+  Emit8(e, 0x80);
+  EmitModRM(e, ext, reg);
+  Emit8(e, value);
+}
+
+// MOV / ADD / OR / AND / SUB / XOR / CMP r8, r8 (opcode is the r/m8, r8 form).
+static void EmitAluReg8(Chip8_JitEmitter *e, int opcode, int dst, int src)
+{
+  EmitRex(e, 0, src, dst);
+  Emit8(e, opcode);
+  EmitModRM(e, src, dst);
+}
+
+// SETcc r8
+static void EmitSetcc(Chip8_JitEmitter *e, int cc, int reg)
+{
+  EmitRex(e, 0, 0, reg);
+  Emit8(e, 0x0F);
+  Emit8(e, 0x90 | cc);
+  EmitModRM(e, 0, reg);
+}
+
+// SHL / SHR r8, 1 (ext is the ModRM opcode extension).
+static void EmitShift1(Chip8_JitEmitter *e, int ext, int reg)
+{
+  EmitRex(e, 0, 0, reg);
+  Emit8(e, 0xD0);
+  EmitModRM(e, ext, reg);
+}
+
+// MOV r8, byte [machine + offset]
+static void EmitLoad8(Chip8_JitEmitter *e, int reg, int offset)
+{
+  EmitRex(e, 0, reg, RBX);
+  Emit8(e, 0x8A);
+  EmitModRMMachine(e, reg, offset);
+}
+
+// MOV byte [machine + offset], r8
+static void EmitStore8(Chip8_JitEmitter *e, int reg, int offset)
+{
+  EmitRex(e, 0, reg, RBX);
+  Emit8(e, 0x88);
+  EmitModRMMachine(e, reg, offset);
+}
+
+// MOVZX r32, r8
+static void EmitMovzx8(Chip8_JitEmitter *e, int dst, int src)
+{
+  EmitRex(e, 0, dst, src);
+  Emit8(e, 0x0F);
+  Emit8(e, 0xB6);
+  EmitModRM(e, dst, src);
+}
+
+// MOVZX r32, word [machine + offset]
+static void EmitLoad16(Chip8_JitEmitter *e, int reg, int offset)
+{
+  Emit8(e, 0x0F);
+  Emit8(e, 0xB7);
+  EmitModRMMachine(e, reg, offset);
+}
+
+// MOV word [machine + offset], r16
+static void EmitStore16(Chip8_JitEmitter *e, int reg, int offset)
+{
+  Emit8(e, 0x66);
+  Emit8(e, 0x89);
+  EmitModRMMachine(e, reg, offset);
+}
+
+// MOV word [machine + offset], imm16
+static void EmitStoreImm16(Chip8_JitEmitter *e, int offset, int value)
+{
+  Emit8(e, 0x66);
+  Emit8(e, 0xC7);
+  EmitModRMMachine(e, 0, offset);
+  Emit16(e, value);
+}
+
+// MOV r32, imm32
+static void EmitMovImm32(Chip8_JitEmitter *e, int reg, int value)
+{
+  Emit8(e, 0xB8 + reg);
+  Emit32(e, value);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_JitProtect
+ * Switches the code buffer between writable and executable, it is never both.
+ *
+ * Parameters:
+ * struct Chip8_Jit *jit - The JIT whose code buffer is switched.
+ * int writable - 1 to allow writing new blocks, 0 to allow running them.
+ *
+ * Returns:
+ * int - 1 on success, 0 if the protection could not be changed.
+ */
+static int Chip8_JitProtect(struct Chip8_Jit *jit, int writable)
+{
+#ifdef _WIN32
+  DWORD previous;
+  return VirtualProtect(jit->Code, CHIP8_JIT_CODESIZE, writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &previous) != 0;
+#else
+  return mprotect(jit->Code, CHIP8_JIT_CODESIZE, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) == 0;
+#endif
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_JitCreate
+ * Allocates the translation state and executable memory for one machine.
+ *
+ * Parameters:
+ * None.
+ *
+ * Returns:
+ * struct Chip8_Jit * - The new JIT, or NULL if it could not be allocated.
+ */
+struct Chip8_Jit *Chip8_JitCreate(void)
+{
+  struct Chip8_Jit *jit = calloc(1, sizeof(struct Chip8_Jit));
+  if (jit == NULL)
+  {
+    return NULL;
+  }
+
+#ifdef _WIN32
+  jit->Code = VirtualAlloc(NULL, CHIP8_JIT_CODESIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+  jit->Code = mmap(NULL, CHIP8_JIT_CODESIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (jit->Code == MAP_FAILED)
+  {
+    jit->Code = NULL;
+  }
+#endif
+
+  if (jit->Code == NULL)
+  {
+    free(jit);
+    return NULL;
+  }
+
+  // The buffer stays executable until a block needs writing.
+  if (!Chip8_JitProtect(jit, 0))
+  {
+    Chip8_JitDestroy(jit);
+    return NULL;
+  }
+  return jit;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_JitDestroy
+ * Frees a JIT created with Chip8_JitCreate.
+ *
+ * Parameters:
+ * struct Chip8_Jit *jit - The JIT to free, may be NULL.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_JitDestroy(struct Chip8_Jit *jit)
+{
+  if (jit == NULL)
+  {
+    return;
+  }
+
+#ifdef _WIN32
+  VirtualFree(jit->Code, 0, MEM_RELEASE);
+#else
+  munmap(jit->Code, CHIP8_JIT_CODESIZE);
+#endif
+  free(jit);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_JitFlush
+ * Throws away every translated block.
+ *
+ * Parameters:
+ * struct Chip8_Jit *jit - The JIT to flush, may be NULL.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_JitFlush(struct Chip8_Jit *jit)
+{
+  if (jit == NULL)
+  {
+    return;
+  }
+
+  jit->CodeUsed = 0;
+  memset(jit->Blocks, 0, sizeof(jit->Blocks));
+  memset(jit->Cycles, 0, sizeof(jit->Cycles));
+  memset(jit->State, 0, sizeof(jit->State));
+  memset(jit->Covered, 0, sizeof(jit->Covered));
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_JitInvalidate
+ * Called when the CPU writes to program memory. If the write lands inside
+ * translated code every block is thrown away, self-modifying code is rare
+ * enough that tracking individual blocks is not worth it.
+ *
+ * Parameters:
+ * struct Chip8_Jit *jit - The JIT to check, may be NULL.
+ * unsigned short address - The first byte written.
+ * int length - The number of bytes written.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_JitInvalidate(struct Chip8_Jit *jit, unsigned short address, int length)
+{
+  if (jit == NULL)
+  {
+    return;
+  }
+
+  for (int i = 0; i < length; i++)
+  {
+    if (jit->Covered[(address + i) & 0xFFF])
+    {
+      Chip8_JitFlush(jit);
+      return;
+    }
+  }
+
+  // The write may have turned an unsupported instruction into a supported one.
+  for (int i = -1; i < length; i++)
+  {
+    if (jit->State[(address + i) & 0xFFF] == CHIP8_JIT_UNSUPPORTED)
+    {
+      jit->State[(address + i) & 0xFFF] = CHIP8_JIT_UNTRANSLATED;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_JitScan
+ * Works out which V registers an OpCode uses and whether the JIT can translate it.
+ *
+ * Parameters:
+ * unsigned short OpCode - The OpCode to check.
+ * int quirks - CHIP8_QUIRK flags of the profile being translated for.
+ * int *registers - Receives a bit mask of the V registers the OpCode uses.
+ * int *terminator - Set to 1 if the OpCode ends the block.
+ *
+ * Returns:
+ * int - 1 if the OpCode can be translated, otherwise 0.
+ */
+static int Chip8_JitScan(unsigned short OpCode, int quirks, int *registers, int *terminator)
+{
+  int x = (OpCode & 0x0F00) >> 8;
+  int y = (OpCode & 0x00F0) >> 4;
+
+  *registers = 0;
+  *terminator = 0;
+
+  switch (OpCode & 0xF000)
+  {
+  // 1NNN - JP addr
+  case 0x1000:
+    *terminator = 1;
+    return 1;
+
+  // 3XKK / 4XKK - SE / SNE Vx, byte
+  case 0x3000:
+  case 0x4000:
+    *registers = 1 << x;
+    *terminator = 1;
+    return 1;
+
+  // 5XY0 / 9XY0 - SE / SNE Vx, Vy
+  case 0x5000:
+  case 0x9000:
+    *registers = (1 << x) | (1 << y);
+    *terminator = 1;
+    return (OpCode & 0x000F) == 0;
+
+  // 6XKK / 7XKK - LD / ADD Vx, byte
+  case 0x6000:
+  case 0x7000:
+    *registers = 1 << x;
+    return 1;
+
+  case 0x8000:
+    *registers = (1 << x) | (1 << y);
+    switch (OpCode & 0x000F)
+    {
+    case 0x0000:
+    case 0x0001:
+    case 0x0002:
+    case 0x0003:
+      return 1;
+
+    // The carry flag is only used while neither operand is VF,
+    // otherwise the order the interpreter writes VF in matters.
+    case 0x0004:
+    case 0x0005:
+    case 0x0007:
+      *registers |= 1 << 0xF;
+      return x != 0xF && y != 0xF;
+
+    case 0x0006:
+    case 0x000E:
+      *registers = (1 << x) | (1 << 0xF) | ((quirks & CHIP8_QUIRK_SHIFTVY) ? 1 << y : 0);
+      return x != 0xF;
+    }
+    return 0;
+
+  // ANNN - LD I, addr
+  case 0xA000:
+    return 1;
+
+  case 0xF000:
+    *registers = 1 << x;
+    switch (OpCode & 0x00FF)
+    {
+    case 0x0007:
+    case 0x0015:
+    case 0x0018:
+    case 0x0029:
+    case 0x0030:
+      return 1;
+
+    case 0x001E:
+      *registers |= 1 << 0xF;
+      return x != 0xF;
+    }
+    return 0;
+  }
+
+  // Everything else (calls, returns, BNNN, CXKK, DXYN, keys, memory) is left to the interpreter.
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_JitTranslate
+ * Translates the basic block starting at an address into x86-64 code.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine whose program memory is translated.
+ * struct Chip8_Jit *jit - The machine's JIT.
+ * unsigned short address - Address of the first instruction.
+ *
+ * Returns:
+ * int - 1 if a block was translated, 0 if the first instruction is unsupported.
+ */
+static int Chip8_JitTranslate(Chip8_Machine *chip8, struct Chip8_Jit *jit, unsigned short address)
+{
+  unsigned short OpCodes[CHIP8_JIT_MAXBLOCK];
+  int HostRegister[16];
+  int count = 0;
+  int cycles = 0;
+  int mapped = 0;
+  int terminated = 0;
+  unsigned short pc = address;
+
+  const int OffsetV = (int)offsetof(Chip8_Machine, VRegister);
+  const int OffsetI = (int)offsetof(Chip8_Machine, IndexRegister);
+  const int OffsetPC = (int)offsetof(Chip8_Machine, ProgramCounter);
+  const int OffsetOpCode = (int)offsetof(Chip8_Machine, OpCode);
+  const int OffsetDelay = (int)offsetof(Chip8_Machine, DelayTimer);
+  const int OffsetSound = (int)offsetof(Chip8_Machine, SoundTimer);
+
+  for (int v = 0; v < 16; v++)
+  {
+    HostRegister[v] = -1;
+  }
+
+  // Find the instructions in the block and give each V register it uses a host register.
+  while (count < CHIP8_JIT_MAXBLOCK && !terminated && pc < 0xFFF)
+  {
+    unsigned short OpCode = (chip8->ProgramMemory[pc] << 8) + chip8->ProgramMemory[pc + 1];
+    int registers, terminator, needed = 0;
+
+    if (!Chip8_JitScan(OpCode, chip8->Quirks, &registers, &terminator))
+    {
+      break;
+    }
+
+    for (int v = 0; v < 16; v++)
+    {
+      if ((registers & (1 << v)) && HostRegister[v] < 0)
+      {
+        needed++;
+      }
+    }
+    if (mapped + needed > CHIP8_JIT_POOLSIZE)
+    {
+      break;
+    }
+    for (int v = 0; v < 16; v++)
+    {
+      if ((registers & (1 << v)) && HostRegister[v] < 0)
+      {
+        HostRegister[v] = Chip8_JitPool[mapped++];
+      }
+    }
+
+    OpCodes[count++] = OpCode;
+    cycles += chip8->CycleCosts[OpCode];
+    terminated = terminator;
+    pc += 2;
+  }
+
+  if (count == 0)
+  {
+    jit->State[address] = CHIP8_JIT_UNSUPPORTED;
+    return 0;
+  }
+
+  // Start again with an empty code buffer if this block might not fit.
+  if (jit->CodeUsed + CHIP8_JIT_MAXCODE > CHIP8_JIT_CODESIZE)
+  {
+    Chip8_JitFlush(jit);
+  }
+
+  // Make the buffer writable while the block is emitted, leaving the address to the interpreter if that fails.
+  if (!Chip8_JitProtect(jit, 1))
+  {
+    jit->State[address] = CHIP8_JIT_UNSUPPORTED;
+    return 0;
+  }
+
+  Chip8_JitEmitter emitter = {jit->Code + jit->CodeUsed, 0};
+  Chip8_JitEmitter *e = &emitter;
+
+  // Prologue, save the registers the ABI needs preserved and keep the machine pointer in RBX.
+  Emit8(e, 0x53);                   // push rbx
+  Emit8(e, 0x56);                   // push rsi
+  Emit8(e, 0x57);                   // push rdi
+  Emit8(e, 0x41); Emit8(e, 0x54);   // push r12
+  Emit8(e, 0x41); Emit8(e, 0x55);   // push r13
+  Emit8(e, 0x41); Emit8(e, 0x56);   // push r14
+  Emit8(e, 0x41); Emit8(e, 0x57);   // push r15
+#ifdef _WIN32
+  Emit8(e, 0x48); Emit8(e, 0x89); Emit8(e, 0xCB); // mov rbx, rcx
+#else
+  Emit8(e, 0x48); Emit8(e, 0x89); Emit8(e, 0xFB); // mov rbx, rdi
+#endif
+
+  // Load the V registers the block uses.
+  for (int v = 0; v < 16; v++)
+  {
+    if (HostRegister[v] >= 0)
+    {
+      EmitLoad8(e, HostRegister[v], OffsetV + v);
+    }
+  }
+
+  // Translate each instruction.
+  pc = address;
+  for (int i = 0; i < count; i++, pc += 2)
+  {
+    unsigned short OpCode = OpCodes[i];
+    int x = HostRegister[(OpCode & 0x0F00) >> 8];
+    int y = HostRegister[(OpCode & 0x00F0) >> 4];
+    int vf = HostRegister[0xF];
+    int kk = OpCode & 0x00FF;
+    int nnn = OpCode & 0x0FFF;
+    int cc = CHIP8_JIT_CC_E;
+
+    switch (OpCode & 0xF000)
+    {
+    // 1NNN - JP addr
+    case 0x1000:
+      EmitStoreImm16(e, OffsetPC, nnn);
+      break;
+
+    // 3XKK / 4XKK / 5XY0 / 9XY0 - Skip if (not) equal.
+    case 0x3000:
+    case 0x4000:
+    case 0x5000:
+    case 0x9000:
+      if ((OpCode & 0xF000) == 0x3000 || (OpCode & 0xF000) == 0x4000)
+      {
+        EmitAluImm8(e, 7, x, kk); // cmp Vx, kk
+      }
+      else
+      {
+        EmitAluReg8(e, 0x38, x, y); // cmp Vx, Vy
+      }
+      if ((OpCode & 0xF000) == 0x4000 || (OpCode & 0xF000) == 0x9000)
+      {
+        cc = CHIP8_JIT_CC_NE;
+      }
+      EmitMovImm32(e, RCX, (pc + 2) & 0xFFFF);
+      EmitMovImm32(e, RDX, (pc + 4) & 0xFFFF);
+      Emit8(e, 0x0F); Emit8(e, 0x40 | cc); EmitModRM(e, RCX, RDX); // cmovcc ecx, edx
+      EmitStore16(e, RCX, OffsetPC);
+      break;
+
+    // 6XKK - LD Vx, kk
+    case 0x6000:
+      EmitMovImm8(e, x, kk);
+      break;
+
+    // 7XKK - ADD Vx, kk
+    case 0x7000:
+      EmitAluImm8(e, 0, x, kk);
+      break;
+
+    case 0x8000:
+      switch (OpCode & 0x000F)
+      {
+      case 0x0000: EmitAluReg8(e, 0x88, x, y); break; // mov Vx, Vy
+      case 0x0001: EmitAluReg8(e, 0x08, x, y); break; // or Vx, Vy
+      case 0x0002: EmitAluReg8(e, 0x20, x, y); break; // and Vx, Vy
+      case 0x0003: EmitAluReg8(e, 0x30, x, y); break; // xor Vx, Vy
+
+      // 8XY4 - ADD Vx, Vy, VF = carry.
+      case 0x0004:
+        EmitAluReg8(e, 0x00, x, y);
+        EmitSetcc(e, CHIP8_JIT_CC_C, vf);
+        break;
+
+      // 8XY5 - SUB Vx, Vy, VF = not borrow.
+      case 0x0005:
+        EmitAluReg8(e, 0x28, x, y);
+        EmitSetcc(e, CHIP8_JIT_CC_NC, vf);
+        break;
+
+      // 8XY6 - SHR Vx, VF = bit shifted out. The profile's quirk is settled here, so the block doesn't test it.
+      case 0x0006:
+        if (chip8->Quirks & CHIP8_QUIRK_SHIFTVY)
+        {
+          EmitAluReg8(e, 0x88, x, y); // mov Vx, Vy
+        }
+        EmitShift1(e, 5, x);
+        EmitSetcc(e, CHIP8_JIT_CC_C, vf);
+        break;
+
+      // 8XY7 - SUBN Vx, Vy, VF = not borrow.
+      case 0x0007:
+        EmitAluReg8(e, 0x88, RAX, y);
+        EmitAluReg8(e, 0x28, RAX, x);
+        EmitSetcc(e, CHIP8_JIT_CC_NC, vf);
+        EmitAluReg8(e, 0x88, x, RAX);
+        break;
+
+      // 8XYE - SHL Vx, VF = bit shifted out.
+      case 0x000E:
+        if (chip8->Quirks & CHIP8_QUIRK_SHIFTVY)
+        {
+          EmitAluReg8(e, 0x88, x, y); // mov Vx, Vy
+        }
+        EmitShift1(e, 4, x);
+        EmitSetcc(e, CHIP8_JIT_CC_C, vf);
+        break;
+      }
+      break;
+
+    // ANNN - LD I, addr
+    case 0xA000:
+      EmitStoreImm16(e, OffsetI, nnn);
+      break;
+
+    case 0xF000:
+      switch (OpCode & 0x00FF)
+      {
+      case 0x0007: EmitLoad8(e, x, OffsetDelay); break;  // LD Vx, DT
+      case 0x0015: EmitStore8(e, x, OffsetDelay); break; // LD DT, Vx
+      case 0x0018: EmitStore8(e, x, OffsetSound); break; // LD ST, Vx
+
+      // FX1E - ADD I, Vx, VF = I + Vx >= 0xFFF.
+      case 0x001E:
+        EmitLoad16(e, RAX, OffsetI);
+        EmitMovzx8(e, RCX, x);
+        Emit8(e, 0x01); EmitModRM(e, RCX, RAX);   // add eax, ecx
+        Emit8(e, 0x3D); Emit32(e, 0xFFF);        // cmp eax, 0xFFF
+        EmitSetcc(e, CHIP8_JIT_CC_NC, vf);
+        EmitStore16(e, RAX, OffsetI);
+        break;
+
+      // FX29 - LD F, Vx
+      case 0x0029:
+        EmitMovzx8(e, RAX, x);
+        Emit8(e, 0x8D); Emit8(e, 0x04); Emit8(e, 0x80); // lea eax, [rax + rax * 4]
+        EmitStore16(e, RAX, OffsetI);
+        break;
+
+      // FX30 - Point I at the large font.
+      case 0x0030:
+        EmitMovzx8(e, RAX, x);
+        Emit8(e, 0x6B); Emit8(e, 0xC0); Emit8(e, 10); // imul eax, eax, 10
+        Emit8(e, 0x83); Emit8(e, 0xC0); Emit8(e, 80); // add eax, 80
+        EmitStore16(e, RAX, OffsetI);
+        break;
+      }
+      break;
+    }
+  }
+
+  // Blocks that don't end in a jump or skip fall through to the next instruction.
+  if (!terminated)
+  {
+    EmitStoreImm16(e, OffsetPC, pc);
+  }
+  EmitStoreImm16(e, OffsetOpCode, OpCodes[count - 1]);
+
+  // Write the V registers back and return the number of cycles used, every instruction costs the same whichever way it goes.
+  for (int v = 0; v < 16; v++)
+  {
+    if (HostRegister[v] >= 0)
+    {
+      EmitStore8(e, HostRegister[v], OffsetV + v);
+    }
+  }
+  EmitMovImm32(e, RAX, cycles);
+
+  // Epilogue.
+  Emit8(e, 0x41); Emit8(e, 0x5F);   // pop r15
+  Emit8(e, 0x41); Emit8(e, 0x5E);   // pop r14
+  Emit8(e, 0x41); Emit8(e, 0x5D);   // pop r13
+  Emit8(e, 0x41); Emit8(e, 0x5C);   // pop r12
+  Emit8(e, 0x5F);                   // pop rdi
+  Emit8(e, 0x5E);                   // pop rsi
+  Emit8(e, 0x5B);                   // pop rbx
+  Emit8(e, 0xC3);                   // ret
+
+  // Make the buffer executable again before the block can be run, none of the blocks in it can run if that fails.
+  if (!Chip8_JitProtect(jit, 0))
+  {
+    Chip8_JitFlush(jit);
+    jit->State[address] = CHIP8_JIT_UNSUPPORTED;
+    return 0;
+  }
+
+  jit->Blocks[address] = (Chip8_JitBlock)(void *)(jit->Code + jit->CodeUsed);
+  jit->Cycles[address] = (unsigned short)cycles;
+  jit->State[address] = CHIP8_JIT_TRANSLATED;
+  memset(&jit->Covered[address], 1, pc - address);
+
+  // Keep each block on a 16 byte boundary.
+  jit->CodeUsed += (e->Size + 15) & ~15;
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_JitGetBlock
+ * Finds, or translates, the block starting at an address.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to run.
+ * unsigned short address - Address of the first instruction.
+ * int *cycles - Receives the number of cycles the block takes.
+ *
+ * Returns:
+ * Chip8_JitBlock - The block, or NULL if the interpreter must run this instruction.
+ */
+Chip8_JitBlock Chip8_JitGetBlock(Chip8_Machine *chip8, unsigned short address, int *cycles)
+{
+  struct Chip8_Jit *jit = chip8->Jit;
+
+  if (address > 0xFFE)
+  {
+    return NULL;
+  }
+
+  if (jit->State[address] == CHIP8_JIT_UNTRANSLATED)
+  {
+    Chip8_JitTranslate(chip8, jit, address);
+  }
+
+  if (jit->State[address] != CHIP8_JIT_TRANSLATED)
+  {
+    return NULL;
+  }
+
+  *cycles = jit->Cycles[address];
+  return jit->Blocks[address];
+}
+
+#else
+
+// Hosts other than x86-64 have no JIT, machines asking for one stay on the interpreter.
+
+struct Chip8_Jit *Chip8_JitCreate(void)
+{
+  return NULL;
+}
+
+void Chip8_JitDestroy(struct Chip8_Jit *jit)
+{
+}
+
+void Chip8_JitFlush(struct Chip8_Jit *jit)
+{
+}
+
+void Chip8_JitInvalidate(struct Chip8_Jit *jit, unsigned short address, int length)
+{
+}
+
+Chip8_JitBlock Chip8_JitGetBlock(Chip8_Machine *chip8, unsigned short address, int *cycles)
+{
+  return NULL;
+}
+
+#endif
@@ -0,0 +1,44 @@
+// MIT License
+//
+// Copyright (c) 2018 - 2022 Les Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+
+#ifndef CHIP8JIT_HEADER
+#define CHIP8JIT_HEADER
+
+#include "chip8.h"
+
+// The JIT is only available when the host is x86-64.
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIP8_JIT_AVAILABLE
+#endif
+
+// A translated basic block, returns the number of cycles its Chip8 instructions took.
+typedef int (*Chip8_JitBlock)(Chip8_Machine *chip8);
+
+// Function prototypes.
+struct Chip8_Jit *Chip8_JitCreate(void);
+void Chip8_JitDestroy(struct Chip8_Jit *jit);
+void Chip8_JitFlush(struct Chip8_Jit *jit);
+void Chip8_JitInvalidate(struct Chip8_Jit *jit, unsigned short address, int length);
+Chip8_JitBlock Chip8_JitGetBlock(Chip8_Machine *chip8, unsigned short address, int *cycles);
+
+#endif
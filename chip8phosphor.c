@@ -0,0 +1,319 @@
+// MIT License
+//
+// Copyright (c) 2018 - 2022 Les Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8phosphor.h"
+
+#ifdef CHIP8_PHOSPHOR_SIMD
+#include <immintrin.h>
+#endif
+
+// Every kernel works out each pixel the same way, so they all give identical output:
+//
+//   Intensity = lit ? 255 : (Intensity * Decay) >> 8
+//   Weight    = Intensity + (Intensity >> 7)             0 to 256
+//   Colour    = (FOREGROUND * Weight + BACKGROUND * (256 - Weight)) >> 8, per channel
+//
+// A pixel is lit when the source pixel is FOREGROUND.
+
+//------------------------------------------------------------------------------
+
+static uint32_t Chip8_PhosphorPixel(TPixel pixel)
+{
+  uint32_t value;
+  memcpy(&value, &pixel, sizeof(value));
+  return value;
+}
+
+/*
+ * Function: Chip8_PhosphorScalar
+ * Blends a run of pixels one at a time, for hosts without SIMD and the end of a row.
+ *
+ * Parameters:
+ * Chip8_Phosphor *phosphor - The phosphor state.
+ * const TPixel *source - The frame just drawn.
+ * TPixel *dest - Where the blended pixels go.
+ * int first - The first pixel to blend.
+ * int count - The number of pixels to blend.
+ *
+ * Returns:
+ * int - 1 if any of the pixels are still fading, otherwise 0.
+ */
+static int Chip8_PhosphorScalar(Chip8_Phosphor *phosphor, const TPixel *source, TPixel *dest, int first, int count)
+{
+  TPixel Fore = FOREGROUND;
+  TPixel Back = BACKGROUND;
+  uint32_t Lit = Chip8_PhosphorPixel(Fore);
+  int Fading = 0;
+
+  for (int i = first; i < first + count; i++)
+  {
+    uint32_t Intensity = phosphor->Intensity[i];
+    if (Chip8_PhosphorPixel(source[i]) == Lit)
+    {
+      Intensity = 255;
+    }
+    else
+    {
+      Intensity = (Intensity * phosphor->Decay) >> 8;
+      Fading |= (Intensity != 0);
+    }
+    phosphor->Intensity[i] = Intensity;
+
+    int Weight = Intensity + (Intensity >> 7);
+    dest[i].r = (Fore.r * Weight + Back.r * (256 - Weight)) >> 8;
+    dest[i].g = (Fore.g * Weight + Back.g * (256 - Weight)) >> 8;
+    dest[i].b = (Fore.b * Weight + Back.b * (256 - Weight)) >> 8;
+    dest[i].a = (Fore.a * Weight + Back.a * (256 - Weight)) >> 8;
+  }
+  return Fading;
+}
+
+#ifdef CHIP8_PHOSPHOR_SIMD
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_PhosphorSSE2
+ * Blends pixels four at a time with SSE2.
+ *
+ * Parameters:
+ * Chip8_Phosphor *phosphor - The phosphor state.
+ * const TPixel *source - The frame just drawn.
+ * TPixel *dest - Where the blended pixels go.
+ * int count - The number of pixels to blend.
+ *
+ * Returns:
+ * int - 1 if any of the pixels are still fading, otherwise 0.
+ */
+__attribute__((target("sse2")))
+static int Chip8_PhosphorSSE2(Chip8_Phosphor *phosphor, const TPixel *source, TPixel *dest, int count)
+{
+  const __m128i Zero = _mm_setzero_si128();
+  const __m128i Lit = _mm_set1_epi32((int)Chip8_PhosphorPixel(FOREGROUND));
+  const __m128i Fore = _mm_unpacklo_epi8(Lit, Zero);
+  const __m128i Back = _mm_unpacklo_epi8(_mm_set1_epi32((int)Chip8_PhosphorPixel(BACKGROUND)), Zero);
+  const __m128i Decay = _mm_set1_epi32(phosphor->Decay);
+  const __m128i Full = _mm_set1_epi32(255);
+  const __m128i Whole = _mm_set1_epi16(256);
+  __m128i Fading = Zero;
+  int i = 0;
+
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128i Pixels = _mm_loadu_si128((const __m128i *)&source[i]);
+    __m128i IsLit = _mm_cmpeq_epi32(Pixels, Lit);
+
+    // Intensity and Decay are both under 256, so a 16 bit multiply in each 32 bit lane is enough.
+    __m128i Intensity = _mm_loadu_si128((const __m128i *)&phosphor->Intensity[i]);
+    Intensity = _mm_srli_epi32(_mm_mullo_epi16(Intensity, Decay), 8);
+    Fading = _mm_or_si128(Fading, _mm_andnot_si128(IsLit, Intensity));
+    Intensity = _mm_or_si128(_mm_and_si128(IsLit, Full), _mm_andnot_si128(IsLit, Intensity));
+    _mm_storeu_si128((__m128i *)&phosphor->Intensity[i], Intensity);
+
+    // Spread each pixel's weight across its four 16 bit channels.
+    __m128i Weight = _mm_add_epi32(Intensity, _mm_srli_epi32(Intensity, 7));
+    Weight = _mm_or_si128(Weight, _mm_slli_epi32(Weight, 16));
+    __m128i Inverse = _mm_sub_epi16(Whole, Weight);
+
+    __m128i Low = _mm_add_epi16(_mm_mullo_epi16(Fore, _mm_unpacklo_epi32(Weight, Weight)),
+                                _mm_mullo_epi16(Back, _mm_unpacklo_epi32(Inverse, Inverse)));
+    __m128i High = _mm_add_epi16(_mm_mullo_epi16(Fore, _mm_unpackhi_epi32(Weight, Weight)),
+                                 _mm_mullo_epi16(Back, _mm_unpackhi_epi32(Inverse, Inverse)));
+    _mm_storeu_si128((__m128i *)&dest[i], _mm_packus_epi16(_mm_srli_epi16(Low, 8), _mm_srli_epi16(High, 8)));
+  }
+
+  int Result = _mm_movemask_epi8(_mm_cmpeq_epi32(Fading, Zero)) != 0xFFFF;
+  return Chip8_PhosphorScalar(phosphor, source, dest, i, count - i) | Result;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_PhosphorAVX2
+ * Blends pixels eight at a time with AVX2, the same steps as Chip8_PhosphorSSE2.
+ * The unpacks and pack work within each 128 bit half, so the pixel order is kept.
+ *
+ * Parameters:
+ * Chip8_Phosphor *phosphor - The phosphor state.
+ * const TPixel *source - The frame just drawn.
+ * TPixel *dest - Where the blended pixels go.
+ * int count - The number of pixels to blend.
+ *
+ * Returns:
+ * int - 1 if any of the pixels are still fading, otherwise 0.
+ */
+__attribute__((target("avx2")))
+static int Chip8_PhosphorAVX2(Chip8_Phosphor *phosphor, const TPixel *source, TPixel *dest, int count)
+{
+  const __m256i Zero = _mm256_setzero_si256();
+  const __m256i Lit = _mm256_set1_epi32((int)Chip8_PhosphorPixel(FOREGROUND));
+  const __m256i Fore = _mm256_unpacklo_epi8(Lit, Zero);
+  const __m256i Back = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)Chip8_PhosphorPixel(BACKGROUND)), Zero);
+  const __m256i Decay = _mm256_set1_epi32(phosphor->Decay);
+  const __m256i Full = _mm256_set1_epi32(255);
+  const __m256i Whole = _mm256_set1_epi16(256);
+  __m256i Fading = Zero;
+  int i = 0;
+
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256i Pixels = _mm256_loadu_si256((const __m256i *)&source[i]);
+    __m256i IsLit = _mm256_cmpeq_epi32(Pixels, Lit);
+
+    __m256i Intensity = _mm256_loadu_si256((const __m256i *)&phosphor->Intensity[i]);
+    Intensity = _mm256_srli_epi32(_mm256_mullo_epi16(Intensity, Decay), 8);
+    Fading = _mm256_or_si256(Fading, _mm256_andnot_si256(IsLit, Intensity));
+    Intensity = _mm256_blendv_epi8(Intensity, Full, IsLit);
+    _mm256_storeu_si256((__m256i *)&phosphor->Intensity[i], Intensity);
+
+    __m256i Weight = _mm256_add_epi32(Intensity, _mm256_srli_epi32(Intensity, 7));
+    Weight = _mm256_or_si256(Weight, _mm256_slli_epi32(Weight, 16));
+    __m256i Inverse = _mm256_sub_epi16(Whole, Weight);
+
+    __m256i Low = _mm256_add_epi16(_mm256_mullo_epi16(Fore, _mm256_unpacklo_epi32(Weight, Weight)),
+                                   _mm256_mullo_epi16(Back, _mm256_unpacklo_epi32(Inverse, Inverse)));
+    __m256i High = _mm256_add_epi16(_mm256_mullo_epi16(Fore, _mm256_unpackhi_epi32(Weight, Weight)),
+                                    _mm256_mullo_epi16(Back, _mm256_unpackhi_epi32(Inverse, Inverse)));
+    _mm256_storeu_si256((__m256i *)&dest[i], _mm256_packus_epi16(_mm256_srli_epi16(Low, 8), _mm256_srli_epi16(High, 8)));
+  }
+
+  int Result = !_mm256_testz_si256(Fading, Fading);
+  return Chip8_PhosphorScalar(phosphor, source, dest, i, count - i) | Result;
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_PhosphorCreate
+ * Creates the phosphor state for bitmaps of a given size, picking the widest
+ * kernel the CPU supports.
+ *
+ * Parameters:
+ * int width - Width of the bitmaps to blend.
+ * int height - Height of the bitmaps to blend.
+ * double decay - Fraction of a pixel's brightness kept each frame after it goes out, 0 to 1.
+ *
+ * Returns:
+ * Chip8_Phosphor * - The new phosphor state, or NULL if it could not be allocated.
+ */
+Chip8_Phosphor *Chip8_PhosphorCreate(int width, int height, double decay)
+{
+  Chip8_Phosphor *phosphor = calloc(1, sizeof(Chip8_Phosphor));
+  if (phosphor == NULL)
+  {
+    return NULL;
+  }
+
+  phosphor->Intensity = calloc((size_t)width * height, sizeof(uint32_t));
+  if (phosphor->Intensity == NULL)
+  {
+    free(phosphor);
+    return NULL;
+  }
+
+  phosphor->Width = width;
+  phosphor->Height = height;
+  phosphor->Decay = (decay <= 0) ? 0 : (decay >= 1) ? 255 : (int)(decay * 256);
+
+  phosphor->Kernel = CHIP8_PHOSPHOR_SCALAR;
+#ifdef CHIP8_PHOSPHOR_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+  {
+    phosphor->Kernel = CHIP8_PHOSPHOR_AVX2;
+  }
+  else if (__builtin_cpu_supports("sse2"))
+  {
+    phosphor->Kernel = CHIP8_PHOSPHOR_SSE2;
+  }
+#endif
+  return phosphor;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_PhosphorDestroy
+ * Frees phosphor state created with Chip8_PhosphorCreate.
+ *
+ * Parameters:
+ * Chip8_Phosphor *phosphor - The phosphor state to free, may be NULL.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_PhosphorDestroy(Chip8_Phosphor *phosphor)
+{
+  if (phosphor == NULL)
+  {
+    return;
+  }
+
+  free(phosphor->Intensity);
+  free(phosphor);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_PhosphorApply
+ * Fades the pixels that have gone out since the last frame and blends the
+ * result over a frame drawn by Chip8_DrawScreen.
+ *
+ * Parameters:
+ * Chip8_Phosphor *phosphor - The phosphor state.
+ * Tigr *source - The frame just drawn, it isn't changed.
+ * Tigr *dest - Where the blended frame goes, the same size as source.
+ *
+ * Returns:
+ * int - 1 if pixels are still fading, so the next frame will differ even if nothing is drawn.
+ */
+int Chip8_PhosphorApply(Chip8_Phosphor *phosphor, Tigr *source, Tigr *dest)
+{
+  int count = phosphor->Width * phosphor->Height;
+
+  if (source->w != phosphor->Width || source->h != phosphor->Height ||
+      dest->w != phosphor->Width || dest->h != phosphor->Height)
+  {
+    return 0;
+  }
+
+  switch (phosphor->Kernel)
+  {
+#ifdef CHIP8_PHOSPHOR_SIMD
+  case CHIP8_PHOSPHOR_AVX2:
+    return Chip8_PhosphorAVX2(phosphor, source->pix, dest->pix, count);
+
+  case CHIP8_PHOSPHOR_SSE2:
+    return Chip8_PhosphorSSE2(phosphor, source->pix, dest->pix, count);
+#endif
+
+  default:
+    return Chip8_PhosphorScalar(phosphor, source->pix, dest->pix, 0, count);
+  }
+}
@@ -0,0 +1,57 @@
+// MIT License
+//
+// Copyright (c) 2018 - 2022 Les Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+
+#ifndef CHIP8PHOSPHOR_HEADER
+#define CHIP8PHOSPHOR_HEADER
+
+#include "chip8.h"
+
+// SIMD kernels need GCC or Clang on an x86 host, everything else uses the scalar kernel.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CHIP8_PHOSPHOR_SIMD
+#endif
+
+enum CHIP8_PHOSPHOR_KERNELS
+{
+    CHIP8_PHOSPHOR_SCALAR = 0,
+    CHIP8_PHOSPHOR_SSE2 = 1,
+    CHIP8_PHOSPHOR_AVX2 = 2
+};
+
+// Phosphor persistence, lit pixels fade out over a few frames instead of
+// vanishing, hiding the flicker of sprites being erased and redrawn with XOR.
+typedef struct Chip8_Phosphor
+{
+    int             Width;                          // Size of the bitmaps it blends.
+    int             Height;
+    int             Decay;                          // Intensity kept each frame, out of 256.
+    int             Kernel;                         // CHIP8_PHOSPHOR_KERNELS in use.
+    uint32_t        *Intensity;                     // Per pixel, 255 when lit, decaying to 0.
+} Chip8_Phosphor;
+
+// Function prototypes.
+Chip8_Phosphor *Chip8_PhosphorCreate(int width, int height, double decay);
+void Chip8_PhosphorDestroy(Chip8_Phosphor *phosphor);
+int Chip8_PhosphorApply(Chip8_Phosphor *phosphor, Tigr *source, Tigr *dest);
+
+#endif
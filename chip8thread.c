@@ -0,0 +1,702 @@
+// MIT License
+//
+// Copyright (c) 2018 - 2022 Les Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+// Condition variables need Vista or later.
+#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0600
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+#include <windows.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include "chip8thread.h"
+#include "chip8filter.h"
+#include "chip8phosphor.h"
+
+#define CHIP8_THREAD_FRAMERATE 60   // Frames emulated per second.
+#define CHIP8_THREAD_MAXLATE 0.1    // Seconds behind before the frame clock gives up catching up.
+
+// Seconds before each frame to stop sleeping and spin, covering how late the scheduler wakes us.
+// The margin follows how late recent sleeps have been, within these limits.
+#define CHIP8_THREAD_MINSPIN 0.0001
+#define CHIP8_THREAD_MAXSPIN 0.001
+#define CHIP8_FRAME_FRESH 4         // Set in Middle when it holds a frame the UI hasn't taken.
+
+// The emulation thread and the three frames it hands to the UI thread.
+//
+// Frames are only ever written by the emulation thread and read by the UI
+// thread. At any time one frame belongs to each of them, Back and Front,
+// and the third is parked in Middle. Publishing swaps Back with Middle and
+// taking swaps Front with Middle, so neither side ever waits for the other.
+struct Chip8_Thread
+{
+  Chip8_Machine *Machine;       // Only touched by the emulation thread while it runs.
+  Chip8_Phosphor *Phosphor;     // Optional persistence stage, NULL when off.
+  Tigr *Source;                 // Frame drawn for the phosphor stage to blend from.
+  int Fading;                   // Set while the phosphor stage has pixels fading out.
+  uint64_t Shown[128];          // Display memory drawn in the newest published frame.
+  int ShownWidth;               // Screen width it was drawn at, 0 before the first frame.
+
+  Tigr *Frames[3];              // Drawn at the window's bitmap size, times the filter's scale.
+  uint64_t FrameDirty[3];       // Rows each frame is missing, emulation thread only.
+  int Back;                     // Frame being drawn, emulation thread only.
+  int Front;                    // Frame being presented, UI thread only.
+  atomic_int Middle;            // Parked frame index, plus CHIP8_FRAME_FRESH.
+
+  atomic_int Keys;              // Chip8 key bits, written by the UI thread.
+  atomic_int Running;           // Cleared to stop the emulation thread.
+  atomic_int LoadRequested;     // Set while ROM_FileName is waiting to be loaded.
+  char ROM_FileName[1024];      // ROM for the emulation thread to load.
+
+  double NextFrame;             // When the next frame is emulated, guarded by Lock.
+  double BusyTime;              // Seconds the emulation thread has spent awake, guarded by Lock.
+  Chip8_Pacing Pacing;          // Frame timing since it was last read, guarded by Lock.
+  double IntervalSquares;       // Sum of the squared frame intervals, for the jitter.
+  double SpinMargin;            // Seconds before each frame the emulation thread stops sleeping.
+
+#ifdef _WIN32
+  HANDLE Handle;
+  SRWLOCK Lock;
+  CONDITION_VARIABLE Published; // Signalled with Lock held whenever a frame is published.
+#else
+  pthread_t Handle;
+  pthread_mutex_t Lock;
+  pthread_cond_t Published;
+#endif
+};
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ThreadTime
+ * Reads a monotonic clock, safe to call from any thread unlike tigrTime.
+ *
+ * Parameters:
+ * None.
+ *
+ * Returns:
+ * double - Seconds since an arbitrary starting point.
+ */
+double Chip8_ThreadTime(void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER Frequency, Counter;
+  QueryPerformanceFrequency(&Frequency);
+  QueryPerformanceCounter(&Counter);
+  return (double)Counter.QuadPart / (double)Frequency.QuadPart;
+#else
+  struct timespec Now;
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return Now.tv_sec + Now.tv_nsec / 1000000000.0;
+#endif
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ThreadSleep
+ * Sleeps the calling thread.
+ *
+ * Parameters:
+ * double seconds - How long to sleep for, nothing happens if 0 or less.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_ThreadSleep(double seconds)
+{
+  if (seconds <= 0)
+  {
+    return;
+  }
+
+#ifdef _WIN32
+  Sleep((DWORD)(seconds * 1000));
+#else
+  struct timespec Delay;
+  Delay.tv_sec = (time_t)seconds;
+  Delay.tv_nsec = (long)((seconds - Delay.tv_sec) * 1000000000.0);
+  nanosleep(&Delay, NULL);
+#endif
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ThreadSleepUntil
+ * Sleeps the calling thread until an absolute time, so the time taken to get
+ * here doesn't add up from frame to frame. The scheduler can wake a sleeping
+ * thread late, so the last stretch is spun instead. The spin margin grows at
+ * once to cover a late wake and shrinks slowly when wakes are on time.
+ *
+ * Parameters:
+ * double until - The Chip8_ThreadTime to wake at.
+ * double *spinMargin - Seconds to spin for, updated from how late this sleep was.
+ *
+ * Returns:
+ * double - Seconds spent spinning.
+ */
+static double Chip8_ThreadSleepUntil(double until, double *spinMargin)
+{
+  double Wake = until - *spinMargin;
+
+#ifdef _WIN32
+  double Now = Chip8_ThreadTime();
+  if (Wake > Now)
+  {
+    Sleep((DWORD)((Wake - Now) * 1000));
+  }
+#else
+  struct timespec Deadline;
+  Deadline.tv_sec = (time_t)Wake;
+  Deadline.tv_nsec = (long)((Wake - Deadline.tv_sec) * 1000000000.0);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &Deadline, NULL) == EINTR)
+  {
+  }
+#endif
+
+  double Spin = Chip8_ThreadTime();
+  double Late = Spin - Wake;
+  if (Late > 0)
+  {
+    *spinMargin = (Late > *spinMargin) ? Late : *spinMargin + (Late - *spinMargin) / 16;
+    *spinMargin = (*spinMargin < CHIP8_THREAD_MINSPIN) ? CHIP8_THREAD_MINSPIN :
+                  (*spinMargin > CHIP8_THREAD_MAXSPIN) ? CHIP8_THREAD_MAXSPIN : *spinMargin;
+  }
+
+  double Now = Spin;
+  while (Now < until)
+  {
+    Now = Chip8_ThreadTime();
+  }
+  return Now - Spin;
+}
+
+static void Chip8_ThreadLock(struct Chip8_Thread *thread)
+{
+#ifdef _WIN32
+  AcquireSRWLockExclusive(&thread->Lock);
+#else
+  pthread_mutex_lock(&thread->Lock);
+#endif
+}
+
+static void Chip8_ThreadUnlock(struct Chip8_Thread *thread)
+{
+#ifdef _WIN32
+  ReleaseSRWLockExclusive(&thread->Lock);
+#else
+  pthread_mutex_unlock(&thread->Lock);
+#endif
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ThreadWaitUntil
+ * Waits on the Published condition, with Lock held, until it is signalled or
+ * the time given has passed. May return early.
+ *
+ * Parameters:
+ * struct Chip8_Thread *thread - The emulation thread.
+ * double until - The Chip8_ThreadTime to give up waiting at.
+ *
+ * Returns:
+ * void.
+ */
+static void Chip8_ThreadWaitUntil(struct Chip8_Thread *thread, double until)
+{
+#ifdef _WIN32
+  double Milliseconds = (until - Chip8_ThreadTime()) * 1000.0;
+  SleepConditionVariableSRW(&thread->Published, &thread->Lock, Milliseconds > 0 ? (DWORD)Milliseconds + 1 : 0, 0);
+#else
+  struct timespec Deadline;
+  Deadline.tv_sec = (time_t)until;
+  Deadline.tv_nsec = (long)((until - Deadline.tv_sec) * 1000000000.0);
+  pthread_cond_timedwait(&thread->Published, &thread->Lock, &Deadline);
+#endif
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ThreadPublish
+ * Draws the rows the back frame is missing and swaps it into Middle for the UI.
+ *
+ * Parameters:
+ * struct Chip8_Thread *thread - The emulation thread.
+ *
+ * Returns:
+ * void.
+ */
+static void Chip8_ThreadPublish(struct Chip8_Thread *thread)
+{
+  Chip8_Machine *chip8 = thread->Machine;
+
+  // A sprite erased and drawn again in the same place leaves the display as it was, so there is nothing new to show.
+  if (!thread->Fading && thread->ShownWidth == chip8->ScreenWidth &&
+      memcmp(thread->Shown, chip8->DisplayMemory, sizeof(thread->Shown)) == 0)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      thread->FrameDirty[i] |= chip8->DirtyRows;
+    }
+    chip8->DirtyRows = 0;
+    chip8->DrawFlag = 0;
+    return;
+  }
+
+  memcpy(thread->Shown, chip8->DisplayMemory, sizeof(thread->Shown));
+  thread->ShownWidth = chip8->ScreenWidth;
+
+  if (thread->Phosphor != NULL)
+  {
+    // The phosphor stage rewrites every pixel, so draw into the source and blend into the frame.
+    Chip8_DrawScreen(chip8, thread->Source);
+    thread->Fading = Chip8_PhosphorApply(thread->Phosphor, thread->Source, thread->Frames[thread->Back]);
+  }
+  else
+  {
+    // Every frame misses the rows changed since it was last drawn.
+    for (int i = 0; i < 3; i++)
+    {
+      thread->FrameDirty[i] |= chip8->DirtyRows;
+    }
+
+    chip8->DirtyRows = thread->FrameDirty[thread->Back];
+    Chip8_DrawScreen(chip8, thread->Frames[thread->Back]);
+    thread->FrameDirty[thread->Back] = 0;
+  }
+
+  thread->Back = atomic_exchange(&thread->Middle, thread->Back | CHIP8_FRAME_FRESH) & 3;
+
+  // Wake the UI thread if it is waiting for a frame.
+  Chip8_ThreadLock(thread);
+#ifdef _WIN32
+  WakeAllConditionVariable(&thread->Published);
+#else
+  pthread_cond_broadcast(&thread->Published);
+#endif
+  Chip8_ThreadUnlock(thread);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ThreadRun
+ * The emulation thread, runs a frame of cycles every 1/60th of a second on its
+ * own clock, so neither the monitor's refresh rate nor a blocked window system
+ * changes the speed of the emulation.
+ *
+ * Parameters:
+ * struct Chip8_Thread *thread - The emulation thread.
+ *
+ * Returns:
+ * void.
+ */
+static void Chip8_ThreadRun(struct Chip8_Thread *thread)
+{
+  Chip8_Machine *chip8 = thread->Machine;
+  double FrameTime = 1.0 / CHIP8_THREAD_FRAMERATE;
+  double NextFrame = Chip8_ThreadTime();
+  double LastFrame = 0;
+
+  while (atomic_load(&thread->Running))
+  {
+    // Load a ROM the UI asked for.
+    if (atomic_load(&thread->LoadRequested))
+    {
+      Chip8_Initialise(chip8);
+      Chip8_LoadROM(chip8, thread->ROM_FileName);
+      atomic_store(&thread->LoadRequested, 0);
+    }
+
+    // The keys arrive at the start of the frame.
+    unsigned short Keys = (unsigned short)atomic_load(&thread->Keys);
+    if (!Chip8_ScheduleKeys(chip8, chip8->Cycles, Keys))
+    {
+      Chip8_SetKeyStates(chip8, Keys);
+    }
+
+    double Now = Chip8_ThreadTime();
+    double Woke = Now;
+
+    // Emulate up to the machine's next vblank, while halted on FX0A only the timers run.
+    // A program ending with 00FD goes back to the splash screen.
+    if (Chip8_EmulateFrame(chip8) == CHIP8_EXIT_EXIT)
+    {
+      Chip8_Initialise(chip8);
+    }
+
+    // Keep publishing while pixels fade out, even if nothing was drawn.
+    if (chip8->DrawFlag || thread->Fading)
+    {
+      Chip8_ThreadPublish(thread);
+    }
+
+    // Wait for the next frame, if we have fallen well behind start again from now.
+    double Deadline = NextFrame;
+    NextFrame += FrameTime;
+    Now = Chip8_ThreadTime();
+    if (Now - NextFrame > CHIP8_THREAD_MAXLATE)
+    {
+      NextFrame = Now;
+    }
+
+    Chip8_ThreadLock(thread);
+    thread->NextFrame = NextFrame;
+    thread->BusyTime += Now - Woke;
+    if (LastFrame > 0)
+    {
+      double Interval = Woke - LastFrame;
+      thread->Pacing.Frames++;
+      thread->Pacing.MeanInterval += Interval;
+      thread->IntervalSquares += Interval * Interval;
+    }
+    if (Woke - Deadline > thread->Pacing.MaxLate)
+    {
+      thread->Pacing.MaxLate = Woke - Deadline;
+    }
+    Chip8_ThreadUnlock(thread);
+    LastFrame = Woke;
+
+    double Spin = Chip8_ThreadSleepUntil(NextFrame, &thread->SpinMargin);
+
+    Chip8_ThreadLock(thread);
+    thread->BusyTime += Spin;
+    Chip8_ThreadUnlock(thread);
+  }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI Chip8_ThreadEntry(LPVOID parameter)
+{
+  Chip8_ThreadRun(parameter);
+  return 0;
+}
+#else
+static void *Chip8_ThreadEntry(void *parameter)
+{
+  Chip8_ThreadRun(parameter);
+  return NULL;
+}
+#endif
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ThreadStart
+ * Starts emulating a machine on its own thread.
+ * The machine belongs to the thread until Chip8_ThreadStop returns.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to run, with its ROM loaded.
+ * int cyclesPerSecond - Cycles to emulate each second, spread evenly over the frames.
+ * Chip8_Phosphor *phosphor - Phosphor stage to blend each frame through, or NULL.
+ *                            It belongs to the thread until Chip8_ThreadStop returns,
+ *                            and must be the size of the frames.
+ *
+ * Returns:
+ * struct Chip8_Thread * - The running thread, or NULL if it could not be started.
+ */
+struct Chip8_Thread *Chip8_ThreadStart(Chip8_Machine *chip8, int cyclesPerSecond, Chip8_Phosphor *phosphor)
+{
+  struct Chip8_Thread *thread = calloc(1, sizeof(struct Chip8_Thread));
+  if (thread == NULL)
+  {
+    return NULL;
+  }
+
+  thread->Machine = chip8;
+  Chip8_SetSpeed(chip8, cyclesPerSecond);
+  thread->Phosphor = phosphor;
+
+  // Frames are the size of the window's bitmap, scaled up by the machine's filter.
+  int Scale = Chip8_FilterScale(chip8->Filter);
+  thread->Source = tigrBitmap(CLIENTWIDTH * Scale, CLIENTHEIGHT * Scale);
+
+  for (int i = 0; i < 3; i++)
+  {
+    thread->Frames[i] = tigrBitmap(CLIENTWIDTH * Scale, CLIENTHEIGHT * Scale);
+    thread->FrameDirty[i] = ~(uint64_t)0;
+  }
+  thread->Back = 0;
+  thread->Front = 1;
+  atomic_init(&thread->Middle, 2);
+  atomic_init(&thread->Keys, 0);
+  atomic_init(&thread->Running, 1);
+  atomic_init(&thread->LoadRequested, 0);
+  thread->NextFrame = Chip8_ThreadTime();
+  thread->SpinMargin = CHIP8_THREAD_MINSPIN;
+
+#ifdef _WIN32
+  InitializeSRWLock(&thread->Lock);
+  InitializeConditionVariable(&thread->Published);
+#else
+  // Timed waits are against the same monotonic clock as Chip8_ThreadTime.
+  pthread_condattr_t Attributes;
+  pthread_condattr_init(&Attributes);
+  pthread_condattr_setclock(&Attributes, CLOCK_MONOTONIC);
+  pthread_mutex_init(&thread->Lock, NULL);
+  pthread_cond_init(&thread->Published, &Attributes);
+  pthread_condattr_destroy(&Attributes);
+#endif
+
+  // The frames start out blank, so the first one published draws everything.
+  chip8->DirtyRows = ~(uint64_t)0;
+  chip8->DrawFlag = 1;
+
+#ifdef _WIN32
+  // Sleep to the millisecond rather than the default scheduler tick.
+  timeBeginPeriod(1);
+  thread->Handle = CreateThread(NULL, 0, Chip8_ThreadEntry, thread, 0, NULL);
+  if (thread->Handle == NULL)
+#else
+  if (pthread_create(&thread->Handle, NULL, Chip8_ThreadEntry, thread) != 0)
+#endif
+  {
+#ifdef _WIN32
+    timeEndPeriod(1);
+#else
+    pthread_cond_destroy(&thread->Published);
+    pthread_mutex_destroy(&thread->Lock);
+#endif
+    for (int i = 0; i < 3; i++)
+    {
+      tigrFree(thread->Frames[i]);
+    }
+    tigrFree(thread->Source);
+    free(thread);
+    return NULL;
+  }
+
+  return thread;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ThreadStop
+ * Stops the emulation thread and waits for it to finish, the machine can be
+ * used again from the calling thread afterwards.
+ *
+ * Parameters:
+ * struct Chip8_Thread *thread - The thread to stop, may be NULL.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_ThreadStop(struct Chip8_Thread *thread)
+{
+  if (thread == NULL)
+  {
+    return;
+  }
+
+  atomic_store(&thread->Running, 0);
+#ifdef _WIN32
+  WaitForSingleObject(thread->Handle, INFINITE);
+  CloseHandle(thread->Handle);
+  timeEndPeriod(1);
+#else
+  pthread_join(thread->Handle, NULL);
+  pthread_cond_destroy(&thread->Published);
+  pthread_mutex_destroy(&thread->Lock);
+#endif
+
+  for (int i = 0; i < 3; i++)
+  {
+    tigrFree(thread->Frames[i]);
+  }
+  tigrFree(thread->Source);
+  free(thread);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ThreadSetKeys
+ * Passes the keypad state to the emulation thread, it is picked up next frame.
+ *
+ * Parameters:
+ * struct Chip8_Thread *thread - The emulation thread.
+ * unsigned short keys - One bit per Chip8 key, as returned by Chip8_ReadKeys.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_ThreadSetKeys(struct Chip8_Thread *thread, unsigned short keys)
+{
+  atomic_store(&thread->Keys, keys);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ThreadLoadROM
+ * Asks the emulation thread to reset the machine and load a ROM.
+ * Waits for any earlier request to be picked up first.
+ *
+ * Parameters:
+ * struct Chip8_Thread *thread - The emulation thread.
+ * const char *ROM_FileName - The ROM to load.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_ThreadLoadROM(struct Chip8_Thread *thread, const char *ROM_FileName)
+{
+  while (atomic_load(&thread->LoadRequested))
+  {
+    Chip8_ThreadSleep(0.001);
+  }
+
+  strncpy(thread->ROM_FileName, ROM_FileName, sizeof(thread->ROM_FileName) - 1);
+  thread->ROM_FileName[sizeof(thread->ROM_FileName) - 1] = '\0';
+  atomic_store(&thread->LoadRequested, 1);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ThreadTakeFrame
+ * Takes the newest frame the emulation thread has published.
+ * The frame stays valid until the next call.
+ *
+ * Parameters:
+ * struct Chip8_Thread *thread - The emulation thread.
+ *
+ * Returns:
+ * Tigr * - The new frame, or NULL if nothing has been drawn since the last call.
+ */
+Tigr *Chip8_ThreadTakeFrame(struct Chip8_Thread *thread)
+{
+  if ((atomic_load(&thread->Middle) & CHIP8_FRAME_FRESH) == 0)
+  {
+    return NULL;
+  }
+
+  thread->Front = atomic_exchange(&thread->Middle, thread->Front) & 3;
+  return thread->Frames[thread->Front];
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ThreadWaitFrame
+ * Sleeps until the emulation thread publishes a frame, or until lead seconds
+ * before it next reads the keys, whichever comes first, then takes the newest
+ * frame like Chip8_ThreadTakeFrame. Waking ahead of the emulation thread lets
+ * the caller pass on fresh input without polling in between.
+ *
+ * Parameters:
+ * struct Chip8_Thread *thread - The emulation thread.
+ * double lead - How long before the next frame to wake up if nothing is published.
+ *
+ * Returns:
+ * Tigr * - The new frame, or NULL if nothing was published before the deadline.
+ */
+Tigr *Chip8_ThreadWaitFrame(struct Chip8_Thread *thread, double lead)
+{
+  double FrameTime = 1.0 / CHIP8_THREAD_FRAMERATE;
+
+  Chip8_ThreadLock(thread);
+
+  // The first deadline still ahead, NextFrame is only updated once the thread has run the frame.
+  double Now = Chip8_ThreadTime();
+  double Until = thread->NextFrame - lead;
+  while (Until <= Now)
+  {
+    Until += FrameTime;
+  }
+
+  while ((atomic_load(&thread->Middle) & CHIP8_FRAME_FRESH) == 0 && Now < Until)
+  {
+    Chip8_ThreadWaitUntil(thread, Until);
+    Now = Chip8_ThreadTime();
+  }
+
+  Chip8_ThreadUnlock(thread);
+  return Chip8_ThreadTakeFrame(thread);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ThreadBusyTime
+ * Reads how long the emulation thread has spent awake, emulating and drawing.
+ *
+ * Parameters:
+ * struct Chip8_Thread *thread - The emulation thread.
+ *
+ * Returns:
+ * double - Seconds spent awake since the thread started.
+ */
+double Chip8_ThreadBusyTime(struct Chip8_Thread *thread)
+{
+  Chip8_ThreadLock(thread);
+  double BusyTime = thread->BusyTime;
+  Chip8_ThreadUnlock(thread);
+  return BusyTime;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: Chip8_ThreadPacing
+ * Reads how evenly the emulation thread has been running its frames since the
+ * last call, and starts counting again.
+ *
+ * Parameters:
+ * struct Chip8_Thread *thread - The emulation thread.
+ * Chip8_Pacing *pacing - Filled with the frame timing.
+ *
+ * Returns:
+ * void.
+ */
+void Chip8_ThreadPacing(struct Chip8_Thread *thread, Chip8_Pacing *pacing)
+{
+  Chip8_ThreadLock(thread);
+  *pacing = thread->Pacing;
+  double Squares = thread->IntervalSquares;
+  memset(&thread->Pacing, 0, sizeof(thread->Pacing));
+  thread->IntervalSquares = 0;
+  Chip8_ThreadUnlock(thread);
+
+  if (pacing->Frames > 0)
+  {
+    pacing->MeanInterval /= pacing->Frames;
+    double Variance = Squares / pacing->Frames - pacing->MeanInterval * pacing->MeanInterval;
+    pacing->Jitter = Variance > 0 ? sqrt(Variance) : 0;
+  }
+}
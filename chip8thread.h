@@ -0,0 +1,55 @@
+// MIT License
+//
+// Copyright (c) 2018 - 2022 Les Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+
+#ifndef CHIP8THREAD_HEADER
+#define CHIP8THREAD_HEADER
+
+#include "chip8.h"
+#include "chip8phosphor.h"
+
+// Emulation thread, runs a machine at 60 frames per second and publishes each
+// frame it draws through a triple buffer for the UI thread to present.
+struct Chip8_Thread;
+
+// How evenly the emulation thread has been running its frames.
+typedef struct Chip8_Pacing
+{
+  long Frames;                  // Frames emulated.
+  double MeanInterval;          // Average seconds from the start of one frame to the next.
+  double Jitter;                // Standard deviation of those intervals, in seconds.
+  double MaxLate;               // Furthest any frame started after its deadline, in seconds.
+} Chip8_Pacing;
+
+// Function prototypes.
+struct Chip8_Thread *Chip8_ThreadStart(Chip8_Machine *chip8, int cyclesPerSecond, Chip8_Phosphor *phosphor);
+void Chip8_ThreadStop(struct Chip8_Thread *thread);
+void Chip8_ThreadSetKeys(struct Chip8_Thread *thread, unsigned short keys);
+void Chip8_ThreadLoadROM(struct Chip8_Thread *thread, const char *ROM_FileName);
+Tigr *Chip8_ThreadTakeFrame(struct Chip8_Thread *thread);
+Tigr *Chip8_ThreadWaitFrame(struct Chip8_Thread *thread, double lead);
+double Chip8_ThreadBusyTime(struct Chip8_Thread *thread);
+void Chip8_ThreadPacing(struct Chip8_Thread *thread, Chip8_Pacing *pacing);
+double Chip8_ThreadTime(void);
+void Chip8_ThreadSleep(double seconds);
+
+#endif
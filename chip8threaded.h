@@ -0,0 +1,435 @@
+// MIT License
+//
+// Copyright (c) 2018 - 2022 Les Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+
+
+// The threaded core, included by chip8.c once for each of CHIP8_PROFILES with
+// CHIP8_THREADED_NAME set to the function to define and CHIP8_THREADED_QUIRKS
+// to the profile's CHIP8_QUIRK flags. C has no templates, so the preprocessor
+// stamps out a copy of the core for each profile and the compiler drops the
+// quirk tests the profile doesn't need. Deliberately has no include guard.
+
+#if !defined(CHIP8_THREADED_NAME) || !defined(CHIP8_THREADED_QUIRKS)
+#error Define CHIP8_THREADED_NAME and CHIP8_THREADED_QUIRKS before including chip8threaded.h
+#endif
+
+/*
+ * Function: CHIP8_THREADED_NAME
+ * Emulates a number of Chip8 CPU cycles using threaded dispatch, with the
+ * quirks of CHIP8_THREADED_QUIRKS.
+ *
+ * Each instruction is dispatched on its top nibble through a 16 entry table
+ * of labels, and every handler jumps straight to the next instruction's
+ * handler instead of returning to a central loop. The operands and cost come
+ * from the decode cache, which the shared handlers clear when the program
+ * writes to memory, so an instruction is only split up on its first visit.
+ * Only the shared handlers can stop the run early, so only they are checked.
+ * The quirks are constants here, so each copy keeps only its own behaviour.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to run.
+ * int cycles - The cycles to run for.
+ *
+ * Returns:
+ * int - The number of cycles used.
+ */
+CHIP8_THREADED_ATTRIBUTES static int CHIP8_THREADED_NAME(Chip8_Machine *chip8, int cycles)
+{
+  int Used = 0;
+  unsigned char *V = chip8->VRegister;
+  unsigned short PC = chip8->ProgramCounter;
+  unsigned short OpCode = chip8->OpCode;
+  Chip8_Instruction *ins;
+
+  // Fetch the next instruction, splitting it up if this is the first visit since it was last written.
+#define CHIP8_FETCH()                                                                                            \
+  ins = &chip8->DecodeCache[PC & 0xFFF];                                                                         \
+  if (ins->Handler == NULL)                                                                                      \
+  {                                                                                                              \
+    Chip8_SplitOpCode(ins, (chip8->ProgramMemory[PC & 0xFFF] << 8) + chip8->ProgramMemory[(PC + 1) & 0xFFF], CHIP8_THREADED_QUIRKS); \
+    ins->Cost = chip8->CycleCosts[ins->OpCode];                                                                  \
+  }                                                                                                              \
+  OpCode = ins->OpCode
+
+  // Run one of the shared instruction handlers directly, they expect the machine to be up to date.
+#define CHIP8_CALL(handler)          \
+  chip8->ProgramCounter = PC;        \
+  chip8->OpCode = OpCode;            \
+  handler(chip8, ins);               \
+  PC = chip8->ProgramCounter
+
+  // Only the instructions that can stop a run need to look.
+#define CHIP8_CHECK_STOP()           \
+  if (chip8->StopReason)             \
+  {                                  \
+    goto Exit;                       \
+  }
+
+  // Rare instructions go through the handler they were decoded with, which also covers unknown OpCodes.
+#define CHIP8_HANDLER()              \
+  CHIP8_CALL(ins->Handler);          \
+  CHIP8_CHECK_STOP()
+
+#ifdef CHIP8_COMPUTED_GOTO
+  static void *const Dispatch[16] = {
+      &&Op0, &&Op1, &&Op2, &&Op3, &&Op4, &&Op5, &&Op6, &&Op7,
+      &&Op8, &&Op9, &&OpA, &&OpB, &&OpC, &&OpD, &&OpE, &&OpF};
+
+  // 8XYN is dispatched a second time on its last nibble, rather than through a bounds checked switch.
+  static void *const Arithmetic[16] = {
+      &&Op80, &&Op81, &&Op82, &&Op83, &&Op84, &&Op85, &&Op86, &&Op87,
+      &&Op8X, &&Op8X, &&Op8X, &&Op8X, &&Op8X, &&Op8X, &&Op8E, &&Op8X};
+
+#define CHIP8_TARGET(nibble) Op##nibble:
+#define CHIP8_ARITHMETIC() goto *Arithmetic[OpCode & 0x000F];
+#define CHIP8_ARITHMETIC_TARGET(nibble) Op8##nibble:
+#define CHIP8_ARITHMETIC_END()
+#define CHIP8_DISPATCH()               \
+  if (Used >= cycles)                  \
+  {                                    \
+    goto Exit;                         \
+  }                                    \
+  CHIP8_FETCH();                       \
+  Used += ins->Cost;                   \
+  goto *Dispatch[OpCode >> 12]
+
+  CHIP8_DISPATCH();
+#else
+#define CHIP8_TARGET(nibble) case 0x##nibble:
+#define CHIP8_ARITHMETIC() switch (OpCode & 0x000F) {
+#define CHIP8_ARITHMETIC_TARGET(nibble) case 0x##nibble:
+#define CHIP8_ARITHMETIC_END() }
+#define CHIP8_DISPATCH() continue
+
+  while (Used < cycles)
+  {
+    CHIP8_FETCH();
+    Used += ins->Cost;
+    switch (OpCode >> 12)
+    {
+#endif
+
+  // 0NNN - CLS, RET, scrolling and SuperChip mode changes.
+  CHIP8_TARGET(0)
+  switch (OpCode)
+  {
+  case 0x00E0:
+    CHIP8_CALL(Chip8_Op00E0);
+    break;
+  case 0x00EE:
+    chip8->StackPointer = (chip8->StackPointer - 1) & 0xF;
+    PC = chip8->Stack[chip8->StackPointer] + 2;
+    break;
+  default:
+    CHIP8_HANDLER();
+    break;
+  }
+  CHIP8_DISPATCH();
+
+  // 1NNN - JP nnn Jump to location nnn.
+  CHIP8_TARGET(1)
+  PC = ins->nnn;
+  CHIP8_DISPATCH();
+
+  // 2NNN - CALL addr
+  CHIP8_TARGET(2)
+  chip8->Stack[chip8->StackPointer] = PC;
+  chip8->StackPointer = (chip8->StackPointer + 1) & 0xF;
+  PC = ins->nnn;
+  CHIP8_DISPATCH();
+
+  // 3XKK - SE Vx, kk
+  // The skips branch to separate dispatches, so the next fetch needn't wait for the compare.
+  CHIP8_TARGET(3)
+  if (V[ins->x] == ins->kk)
+  {
+    PC += 4;
+    CHIP8_DISPATCH();
+  }
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  // 4XKK - SNE Vx, byte
+  CHIP8_TARGET(4)
+  if (V[ins->x] != ins->kk)
+  {
+    PC += 4;
+    CHIP8_DISPATCH();
+  }
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  // 5XY0 - SE Vx, Vy
+  CHIP8_TARGET(5)
+  if (V[ins->x] == V[ins->y])
+  {
+    PC += 4;
+    CHIP8_DISPATCH();
+  }
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  // 6XKK - LD Vx, kk
+  CHIP8_TARGET(6)
+  V[ins->x] = ins->kk;
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  // 7XKK - ADD Vx, kk
+  CHIP8_TARGET(7)
+  V[ins->x] += ins->kk;
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  // 8XYN - Register to register arithmetic.
+  CHIP8_TARGET(8)
+  CHIP8_ARITHMETIC()
+
+  CHIP8_ARITHMETIC_TARGET(0)
+  V[ins->x] = V[ins->y];
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  CHIP8_ARITHMETIC_TARGET(1)
+  V[ins->x] |= V[ins->y];
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  CHIP8_ARITHMETIC_TARGET(2)
+  V[ins->x] &= V[ins->y];
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  CHIP8_ARITHMETIC_TARGET(3)
+  V[ins->x] ^= V[ins->y];
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  CHIP8_ARITHMETIC_TARGET(4)
+  V[0xF] = (V[ins->y] > (255 - V[ins->x])) ? 1 : 0;
+  V[ins->x] += V[ins->y];
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  CHIP8_ARITHMETIC_TARGET(5)
+  V[0xF] = (V[ins->x] >= V[ins->y]) ? 1 : 0;
+  V[ins->x] -= V[ins->y];
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  CHIP8_ARITHMETIC_TARGET(6)
+  if (CHIP8_THREADED_QUIRKS & CHIP8_QUIRK_SHIFTVY)
+  {
+    V[ins->x] = V[ins->y];
+  }
+  V[0xF] = V[ins->x] & 0x1;
+  V[ins->x] = V[ins->x] / 2;
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  CHIP8_ARITHMETIC_TARGET(7)
+  V[0xF] = (V[ins->y] >= V[ins->x]) ? 1 : 0;
+  V[ins->x] = V[ins->y] - V[ins->x];
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  CHIP8_ARITHMETIC_TARGET(E)
+  if (CHIP8_THREADED_QUIRKS & CHIP8_QUIRK_SHIFTVY)
+  {
+    V[ins->x] = V[ins->y];
+  }
+  V[0xF] = V[ins->x] >> 7;
+  V[ins->x] = V[ins->x] * 2;
+  PC += 2;
+  CHIP8_DISPATCH();
+
+#ifdef CHIP8_COMPUTED_GOTO
+  Op8X:
+#else
+  default:
+#endif
+  // Unknown OpCode, leave the program counter where it is.
+  chip8->StopReason = CHIP8_EXIT_INVALID;
+  goto Exit;
+  CHIP8_ARITHMETIC_END()
+
+  // 9XY0 - SNE Vx, Vy
+  CHIP8_TARGET(9)
+  if (V[ins->x] != V[ins->y])
+  {
+    PC += 4;
+    CHIP8_DISPATCH();
+  }
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  // ANNN - LD I, addr
+  CHIP8_TARGET(A)
+  chip8->IndexRegister = ins->nnn;
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  // BNNN - JP V0, addr, or BXNN - JP Vx, addr with CHIP8_QUIRK_JUMPVX
+  CHIP8_TARGET(B)
+  PC = ins->nnn + V[(CHIP8_THREADED_QUIRKS & CHIP8_QUIRK_JUMPVX) ? ins->x : 0];
+  CHIP8_DISPATCH();
+
+  // CXKK - RND Vx, byte
+  CHIP8_TARGET(C)
+  V[ins->x] = Chip8_Random(chip8) & ins->kk;
+  PC += 2;
+  CHIP8_DISPATCH();
+
+  // DXYN - DRW Vx, Vy, height
+  CHIP8_TARGET(D)
+  switch (CHIP8_THREADED_QUIRKS & (CHIP8_QUIRK_CLIP | CHIP8_QUIRK_DISPLAYWAIT))
+  {
+  case CHIP8_QUIRK_CLIP:
+    CHIP8_CALL(Chip8_OpDXYNClip);
+    break;
+  case CHIP8_QUIRK_DISPLAYWAIT:
+    CHIP8_CALL(Chip8_OpDXYNWait);
+    CHIP8_CHECK_STOP();
+    break;
+  case CHIP8_QUIRK_CLIP | CHIP8_QUIRK_DISPLAYWAIT:
+    CHIP8_CALL(Chip8_OpDXYNClipWait);
+    CHIP8_CHECK_STOP();
+    break;
+  default:
+    CHIP8_CALL(Chip8_OpDXYN);
+    break;
+  }
+  CHIP8_DISPATCH();
+
+  // EXNN - Keyboard skips.
+  CHIP8_TARGET(E)
+  switch (ins->kk)
+  {
+  case 0x009E:
+    if (chip8->KeyStates[V[ins->x]] == CHIP8_KEYDOWN)
+    {
+      PC += 4;
+      CHIP8_DISPATCH();
+    }
+    PC += 2;
+    break;
+  case 0x00A1:
+    if (chip8->KeyStates[V[ins->x]] == CHIP8_KEYUP)
+    {
+      PC += 4;
+      CHIP8_DISPATCH();
+    }
+    PC += 2;
+    break;
+  default:
+    CHIP8_HANDLER();
+    break;
+  }
+  CHIP8_DISPATCH();
+
+  // FXNN - Timers, memory and the index register.
+  CHIP8_TARGET(F)
+  switch (ins->kk)
+  {
+  case 0x0007:
+    V[ins->x] = chip8->DelayTimer;
+    break;
+  case 0x0015:
+    chip8->DelayTimer = V[ins->x];
+    break;
+  case 0x0018:
+    chip8->SoundTimer = V[ins->x];
+    break;
+  case 0x0029:
+    chip8->IndexRegister = V[ins->x] * 0x5;
+    break;
+  case 0x000A:
+    CHIP8_CALL(Chip8_OpFX0A);
+    CHIP8_CHECK_STOP();
+    CHIP8_DISPATCH();
+  case 0x001E:
+    CHIP8_CALL(Chip8_OpFX1E);
+    CHIP8_DISPATCH();
+  case 0x0033:
+    CHIP8_CALL(Chip8_OpFX33);
+    CHIP8_DISPATCH();
+  case 0x0055:
+    if (CHIP8_THREADED_QUIRKS & CHIP8_QUIRK_LOADSTORE)
+    {
+      CHIP8_CALL(Chip8_OpFX55Past);
+    }
+    else if (CHIP8_THREADED_QUIRKS & CHIP8_QUIRK_LOADSTOREX)
+    {
+      CHIP8_CALL(Chip8_OpFX55Last);
+    }
+    else
+    {
+      CHIP8_CALL(Chip8_OpFX55);
+    }
+    CHIP8_DISPATCH();
+  case 0x0065:
+    if (CHIP8_THREADED_QUIRKS & CHIP8_QUIRK_LOADSTORE)
+    {
+      CHIP8_CALL(Chip8_OpFX65Past);
+    }
+    else if (CHIP8_THREADED_QUIRKS & CHIP8_QUIRK_LOADSTOREX)
+    {
+      CHIP8_CALL(Chip8_OpFX65Last);
+    }
+    else
+    {
+      CHIP8_CALL(Chip8_OpFX65);
+    }
+    CHIP8_DISPATCH();
+  default:
+    CHIP8_HANDLER();
+    CHIP8_DISPATCH();
+  }
+  PC += 2;
+  CHIP8_DISPATCH();
+
+#ifndef CHIP8_COMPUTED_GOTO
+    }
+  }
+#endif
+
+Exit:
+  // The program counter and OpCode are kept in locals while running.
+  chip8->ProgramCounter = PC;
+  chip8->OpCode = OpCode;
+
+  // An instruction is charged as it is fetched, so this includes one that stopped the run.
+  return Used;
+
+#undef CHIP8_FETCH
+#undef CHIP8_CALL
+#undef CHIP8_CHECK_STOP
+#undef CHIP8_HANDLER
+#undef CHIP8_TARGET
+#undef CHIP8_ARITHMETIC
+#undef CHIP8_ARITHMETIC_TARGET
+#undef CHIP8_ARITHMETIC_END
+#undef CHIP8_DISPATCH
+}
+
+#undef CHIP8_THREADED_NAME
+#undef CHIP8_THREADED_QUIRKS
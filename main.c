@@ -0,0 +1,922 @@
+// MIT License
+//
+// Copyright (c) 2018 - 2022 Les Farrell
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "chip8filter.h"
+#include "chip8phosphor.h"
+#include "chip8thread.h"
+#include "console.h"
+#include "filedialogs.h"
+
+const double INPUTLEADTIME = 0.001;     // Seconds before each emulated frame the keys are read.
+const int BENCHMARKSPEED = 50000000;    // Cycles per second the benchmark paces the timers for.
+const uint32_t HEADLESSSEED = 1;        // Random seed for headless runs when -seed isn't given.
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: RunBenchmark
+ * Runs the loaded ROM as fast as possible without a window and reports the
+ * machine cycles run per second and how many instructions were fused.
+ * Under the flat timing model every instruction is one cycle, so that is
+ * also the instructions per second. The timers tick by cycle count, paced
+ * for roughly what the faster cores manage, so every run of a ROM executes
+ * the same instructions. The run ends early if the program reaches 00FD or
+ * an unknown OpCode, and only the cycles that ran are counted.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to run.
+ * long cycles - The number of machine cycles to run.
+ *
+ * Returns:
+ * void.
+ */
+static void RunBenchmark(Chip8_Machine *chip8, long cycles)
+{
+  static const char *CoreNames[] = {"Decoded", "Threaded", "JIT", "Compiled"};
+  const int BatchSize = 1000000;
+  long executed = 0;
+  double elapsed = 0;
+  int Reason = CHIP8_EXIT_BUDGET;
+
+  Chip8_SetSpeed(chip8, BENCHMARKSPEED);
+  uint64_t Start = chip8->Cycles;
+
+  tigrTime();
+  while (executed < cycles && Reason == CHIP8_EXIT_BUDGET)
+  {
+    int batch = (cycles - executed < BatchSize) ? (int)(cycles - executed) : BatchSize;
+    Reason = Chip8_Run(chip8, batch, 0);
+    executed = (long)(chip8->Cycles - Start);
+  }
+  elapsed = tigrTime();
+
+  if (Reason == CHIP8_EXIT_INVALID)
+  {
+    printf("Stopped on unknown OpCode %04X at %03X\n", chip8->OpCode, chip8->ProgramCounter);
+  }
+  else if (Reason == CHIP8_EXIT_EXIT)
+  {
+    printf("Program exited\n");
+  }
+
+  printf("%s core: %ld cycles in %.3f seconds, %.0f cycles per second\n",
+         CoreNames[chip8->Core],
+         executed, elapsed, elapsed > 0 ? executed / elapsed : 0);
+  Chip8_ShowFusionStats(chip8);
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: RunHeadless
+ * Runs the loaded ROM for a number of frames without a window, as fast as
+ * the host allows, and prints a hash of the final machine state. The run
+ * ends early if the program reaches 00FD or an unknown OpCode. Time is
+ * counted in machine cycles, so the timers tick exactly as they would in
+ * real time and the same ROM, seed, speed and input always give the same
+ * hash, whatever the core or host.
+ *
+ * The input file has one line per key change, the frame it happens at and
+ * the keys down from then on as a hex mask of Chip8 keys, bit n for key n.
+ * Frames count from 0 and must not go backwards, # starts a comment.
+ *
+ *   # Hold key 5 for frames 10 to 19.
+ *   10 0020
+ *   20 0000
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to run.
+ * int frames - The number of 60Hz frames to run.
+ * const char *inputFileName - The key changes to replay, NULL for none.
+ * int trace - Print the state hash after every frame as well.
+ *
+ * Returns:
+ * int - EXIT_SUCCESS, or EXIT_FAILURE if the input can't be read.
+ */
+static int RunHeadless(Chip8_Machine *chip8, int frames, const char *inputFileName, int trace)
+{
+  FILE *Input = NULL;
+  char Line[256];
+  long NextFrame = -1;
+  unsigned int NextKeys = 0;
+  double elapsed = 0;
+  int frame = 0;
+  int Reason = CHIP8_EXIT_VBLANK;
+
+  if (inputFileName != NULL)
+  {
+    Input = fopen(inputFileName, "r");
+    if (Input == NULL)
+    {
+      printf("Unable to open %s\n", inputFileName);
+      return EXIT_FAILURE;
+    }
+  }
+
+  tigrTime();
+  for (frame = 0; frame < frames && Reason == CHIP8_EXIT_VBLANK; frame++)
+  {
+    // Deliver every key change due at the start of this frame, in file order.
+    while (Input != NULL)
+    {
+      if (NextFrame < 0)
+      {
+        if (fgets(Line, sizeof(Line), Input) == NULL)
+        {
+          fclose(Input);
+          Input = NULL;
+          break;
+        }
+        char *Comment = strchr(Line, '#');
+        if (Comment != NULL)
+        {
+          *Comment = '\0';
+        }
+        if (sscanf(Line, "%ld %x", &NextFrame, &NextKeys) != 2)
+        {
+          NextFrame = -1;
+          continue;
+        }
+      }
+      if (NextFrame > frame)
+      {
+        break;
+      }
+      if (!Chip8_ScheduleKeys(chip8, chip8->Cycles, (unsigned short)NextKeys))
+      {
+        Chip8_SetKeyStates(chip8, (unsigned short)NextKeys);
+      }
+      NextFrame = -1;
+    }
+
+    Reason = Chip8_EmulateFrame(chip8);
+    if (trace)
+    {
+      printf("%d %016llx\n", frame, (unsigned long long)Chip8_StateHash(chip8));
+    }
+  }
+  elapsed = tigrTime();
+
+  if (Input != NULL)
+  {
+    fclose(Input);
+  }
+
+  if (Reason == CHIP8_EXIT_INVALID)
+  {
+    printf("Stopped in frame %d on unknown OpCode %04X at %03X\n", frame - 1, chip8->OpCode, chip8->ProgramCounter);
+  }
+  else if (Reason == CHIP8_EXIT_EXIT)
+  {
+    printf("Program exited in frame %d\n", frame - 1);
+  }
+
+  printf("%d frames, %llu cycles in %.3f seconds, %.1f times real time\n",
+         frame, (unsigned long long)chip8->Cycles, elapsed, elapsed > 0 ? frame / 60.0 / elapsed : 0);
+  printf("State hash %016llx\n", (unsigned long long)Chip8_StateHash(chip8));
+  return EXIT_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: RunFillBenchmark
+ * Times tigrClear and tigrFill with each of tigr's kernels at common window
+ * sizes and checks that they all draw the same pixels. tigrFill is timed by
+ * redrawing the whole screen with Chip8_DrawScreenFill.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to draw.
+ * int frames - The number of clears and redraws to time for each kernel.
+ *
+ * Returns:
+ * int - EXIT_SUCCESS, or EXIT_FAILURE if the kernels' output differs.
+ */
+static int RunFillBenchmark(Chip8_Machine *chip8, int frames)
+{
+  static const char *KernelNames[] = {"Scalar", "SSE2", "AVX2"};
+  static const int Sizes[][2] = {{640, 320}, {1280, 640}, {1920, 1080}};
+  int Result = EXIT_SUCCESS;
+
+  for (int size = 0; size < 3; size++)
+  {
+    Tigr *Bitmaps[3];
+    int Kernels = 0;
+
+    for (int kernel = TIGR_KERNEL_SCALAR; kernel <= TIGR_KERNEL_AVX2; kernel++)
+    {
+      // Kernels the CPU doesn't support fall back to one already timed.
+      if (tigrSetKernel(kernel) != kernel)
+      {
+        break;
+      }
+
+      Tigr *Bitmap = tigrBitmap(Sizes[size][0], Sizes[size][1]);
+      double Clear, Fill;
+
+      tigrTime();
+      for (int frame = 0; frame < frames; frame++)
+      {
+        tigrClear(Bitmap, (frame & 1) ? FOREGROUND : BACKGROUND);
+      }
+      Clear = tigrTime();
+
+      tigrClear(Bitmap, BACKGROUND);
+      tigrTime();
+      for (int frame = 0; frame < frames; frame++)
+      {
+        chip8->DirtyRows = ~(uint64_t)0;
+        chip8->DrawFlag = 1;
+        Chip8_DrawScreenFill(chip8, Bitmap);
+      }
+      Fill = tigrTime();
+
+      printf("%s kernel at %dx%d: tigrClear %.1f microseconds, tigrFill redraw %.1f microseconds per frame\n",
+             KernelNames[kernel], Bitmap->w, Bitmap->h,
+             frames > 0 ? Clear * 1000000.0 / frames : 0, frames > 0 ? Fill * 1000000.0 / frames : 0);
+      Bitmaps[Kernels++] = Bitmap;
+    }
+
+    for (int kernel = 0; kernel < Kernels; kernel++)
+    {
+      if (memcmp(Bitmaps[0]->pix, Bitmaps[kernel]->pix, Bitmaps[0]->w * Bitmaps[0]->h * sizeof(TPixel)) != 0)
+      {
+        printf("%s kernel output differs\n", KernelNames[kernel]);
+        Result = EXIT_FAILURE;
+      }
+    }
+    for (int kernel = 0; kernel < Kernels; kernel++)
+    {
+      tigrFree(Bitmaps[kernel]);
+    }
+  }
+
+  tigrSetKernel(TIGR_KERNEL_AUTO);
+  return Result;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: RunDrawBenchmark
+ * Runs the loaded ROM for a second to put something on the screen, then times
+ * redrawing the whole screen with the lookup table and tigrFill renderers and
+ * checks that they drew the same pixels. Then times tigr's fill kernels.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to draw.
+ * int frames - The number of full screen redraws to time for each renderer.
+ *
+ * Returns:
+ * int - EXIT_SUCCESS, or EXIT_FAILURE if the renderers' output differs.
+ */
+static int RunDrawBenchmark(Chip8_Machine *chip8, int frames)
+{
+  static const char *RendererNames[] = {"Lookup table", "tigrFill"};
+  Tigr *Bitmaps[2];
+  double elapsed[2];
+  int Result = EXIT_SUCCESS;
+
+  for (int frame = 0; frame < 60; frame++)
+  {
+    Chip8_EmulateFrame(chip8);
+  }
+
+  for (int renderer = 0; renderer < 2; renderer++)
+  {
+    Bitmaps[renderer] = tigrBitmap(CLIENTWIDTH, CLIENTHEIGHT);
+
+    tigrTime();
+    for (int frame = 0; frame < frames; frame++)
+    {
+      // Force a full redraw every frame.
+      chip8->DirtyRows = ~(uint64_t)0;
+      chip8->DrawFlag = 1;
+      if (renderer == 0)
+      {
+        Chip8_DrawScreen(chip8, Bitmaps[renderer]);
+      }
+      else
+      {
+        Chip8_DrawScreenFill(chip8, Bitmaps[renderer]);
+      }
+    }
+    elapsed[renderer] = tigrTime();
+
+    printf("%s renderer: %d frames of %dx%d in %.3f seconds, %.1f microseconds per frame\n",
+           RendererNames[renderer], frames, chip8->ScreenWidth, chip8->ScreenHeight,
+           elapsed[renderer], frames > 0 ? elapsed[renderer] * 1000000.0 / frames : 0);
+  }
+
+  if (memcmp(Bitmaps[0]->pix, Bitmaps[1]->pix, CLIENTWIDTH * CLIENTHEIGHT * sizeof(TPixel)) != 0)
+  {
+    printf("Renderer output differs\n");
+    Result = EXIT_FAILURE;
+  }
+  else if (elapsed[0] > 0)
+  {
+    printf("Lookup table renderer is %.1fx faster\n", elapsed[1] / elapsed[0]);
+  }
+
+  tigrFree(Bitmaps[0]);
+  tigrFree(Bitmaps[1]);
+
+  // Time the lookup table renderer through each of the upscaling filters.
+  for (int filter = CHIP8_FILTER_SCALE2X; filter <= CHIP8_FILTER_SCALE3X; filter++)
+  {
+    int Scale = Chip8_FilterScale(filter);
+    Tigr *Bitmap = tigrBitmap(CLIENTWIDTH * Scale, CLIENTHEIGHT * Scale);
+    double Elapsed;
+
+    chip8->Filter = filter;
+    tigrTime();
+    for (int frame = 0; frame < frames; frame++)
+    {
+      chip8->DirtyRows = ~(uint64_t)0;
+      chip8->DrawFlag = 1;
+      Chip8_DrawScreen(chip8, Bitmap);
+    }
+    Elapsed = tigrTime();
+
+    printf("Scale%dx filter: %d frames of %dx%d in %.3f seconds, %.1f microseconds per frame\n",
+           Scale, frames, Bitmap->w, Bitmap->h, Elapsed, frames > 0 ? Elapsed * 1000000.0 / frames : 0);
+    tigrFree(Bitmap);
+  }
+  chip8->Filter = CHIP8_FILTER_NONE;
+
+  if (RunFillBenchmark(chip8, frames) != EXIT_SUCCESS)
+  {
+    Result = EXIT_FAILURE;
+  }
+
+  return Result;
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: RunPresentBenchmark
+ * Runs the loaded ROM for a second to put something on the screen, then opens
+ * a window with each of tigr's present paths in turn and times presenting the
+ * whole screen to it. Without a software path both windows use OpenGL.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to draw.
+ * int frames - The number of frames to present through each path.
+ *
+ * Returns:
+ * void.
+ */
+static void RunPresentBenchmark(Chip8_Machine *chip8, int frames)
+{
+  static const char *PathNames[] = {"OpenGL", "Software"};
+  static const int PathFlags[] = {0, TIGR_SOFTWARE};
+
+  for (int frame = 0; frame < 60; frame++)
+  {
+    Chip8_EmulateFrame(chip8);
+  }
+
+  for (int path = 0; path < 2; path++)
+  {
+    Tigr *screen = tigrWindow(CLIENTWIDTH, CLIENTHEIGHT, "Super Chip", TIGR_FIXED | PathFlags[path]);
+    double elapsed;
+
+    chip8->DirtyRows = ~(uint64_t)0;
+    chip8->DrawFlag = 1;
+    Chip8_DrawScreen(chip8, screen);
+
+    // Let the window map before timing.
+    tigrUpdate(screen);
+    tigrTime();
+    for (int frame = 0; frame < frames && !tigrClosed(screen); frame++)
+    {
+      tigrUpdate(screen);
+    }
+    elapsed = tigrTime();
+
+    printf("%s present: %d frames of %dx%d in %.3f seconds, %.1f microseconds per frame\n",
+           PathNames[path], frames, screen->w, screen->h,
+           elapsed, frames > 0 ? elapsed * 1000000.0 / frames : 0);
+    tigrFree(screen);
+  }
+}
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: CheckROMKeys
+ * Handles the keys that reload the current ROM or open a different one.
+ *
+ * Parameters:
+ * Tigr *screen - The window to read the keys from.
+ * char *ROM_FileName - The current ROM, replaced if a different one is opened.
+ * long size - The size of the ROM_FileName buffer.
+ *
+ * Returns:
+ * int - 1 if ROM_FileName should be loaded, otherwise 0.
+ */
+static int CheckROMKeys(Tigr *screen, char *ROM_FileName, long size)
+{
+  // Reload the current rom if 'L' pressed
+  if (tigrKeyDown(screen, 'L'))
+  {
+    return 1;
+  }
+
+  // Open a different ROM file if 'O' pressed
+  if (tigrKeyDown(screen, 'O'))
+  {
+    OpenFileDialog(ROM_FileName, size);
+    return strlen(ROM_FileName) > 0;
+  }
+  return 0;
+}
+
+#ifdef NDEBUG
+//------------------------------------------------------------------------------
+
+/*
+ * Function: RunDebugger
+ * Runs the machine one instruction at a time, stepping forwards with the right
+ * arrow and back with the left, showing the registers in the console.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to run.
+ * Tigr *screen - The application window.
+ * char *ROM_FileName - The loaded ROM.
+ * long size - The size of the ROM_FileName buffer.
+ *
+ * Returns:
+ * void.
+ */
+static void RunDebugger(Chip8_Machine *chip8, Tigr *screen, char *ROM_FileName, long size)
+{
+  Console_Show("Debug Window");
+
+  // Loop until the user exits.
+  while (!tigrClosed(screen) && !tigrKeyDown(screen, TK_ESCAPE))
+  {
+    // Disassemble the current command.
+    Chip8_Disassemble(chip8);
+
+    if (tigrKeyDown(screen, TK_RIGHT) || tigrKeyHeld(screen, TK_RIGHT))
+    {
+      Chip8_EmulateCPU(chip8);
+    }
+
+    if (tigrKeyDown(screen, TK_LEFT))
+    {
+      chip8->ProgramCounter -= 2;
+      if (chip8->ProgramCounter <= 512)
+      {
+        chip8->ProgramCounter = 512;
+      }
+      Chip8_Disassemble(chip8);
+      Chip8_EmulateCPU(chip8);
+    }
+
+    // A program ending with 00FD goes back to the splash screen.
+    if (chip8->RunState == CHIP8_EXITED)
+    {
+      Chip8_Initialise(chip8);
+    }
+
+    // Process the keypress states.
+    Chip8_GetKeyStates(chip8, screen);
+
+    // Show the chip register states.
+    Chip8_ShowProgramState(chip8);
+
+    if (CheckROMKeys(screen, ROM_FileName, size))
+    {
+      Chip8_Initialise(chip8);
+      Chip8_LoadROM(chip8, ROM_FileName);
+    }
+
+    // Redraw the rows of the chip8 screen that changed, only present the window when something was drawn.
+    if (Chip8_DrawScreen(chip8, screen))
+    {
+      tigrUpdate(screen);
+    }
+    else
+    {
+      tigrPollInput(screen);
+    }
+  }
+}
+
+#else
+//------------------------------------------------------------------------------
+
+/*
+ * Function: RunThreaded
+ * Runs the machine on its own thread while this one only presents the frames
+ * it publishes and passes on the input, so a window system that blocks in
+ * tigrUpdate doesn't stall the emulation.
+ *
+ * Parameters:
+ * Chip8_Machine *chip8 - The machine to run, it belongs to the emulation thread until this returns.
+ * Tigr *screen - The application window.
+ * char *ROM_FileName - The loaded ROM.
+ * long size - The size of the ROM_FileName buffer.
+ * double phosphorDecay - Brightness kept each frame by pixels going out, 0 for no phosphor stage.
+ * int cyclesPerSecond - The speed to emulate at.
+ * int dutyCycle - Report how much of each second both threads spent awake.
+ * int pacing - Report how evenly the emulation thread ran its frames each second.
+ *
+ * Returns:
+ * void.
+ */
+static void RunThreaded(Chip8_Machine *chip8, Tigr *screen, char *ROM_FileName, long size, double phosphorDecay,
+                        int cyclesPerSecond, int dutyCycle, int pacing)
+{
+  Chip8_Phosphor *phosphor = NULL;
+  if (phosphorDecay > 0)
+  {
+    phosphor = Chip8_PhosphorCreate(screen->w, screen->h, phosphorDecay);
+  }
+
+  struct Chip8_Thread *thread = Chip8_ThreadStart(chip8, cyclesPerSecond, phosphor);
+  if (thread == NULL)
+  {
+    printf("Unable to start the emulation thread\n");
+    Chip8_PhosphorDestroy(phosphor);
+    return;
+  }
+
+  // Duty cycle statistics for the current reporting period.
+  double ReportStart = Chip8_ThreadTime();
+  double EmulationBusy = Chip8_ThreadBusyTime(thread);
+  double Asleep = 0;
+  long Wakeups = 0;
+  long Presented = 0;
+
+  // Loop until the user exits.
+  while (!tigrClosed(screen) && !tigrKeyDown(screen, TK_ESCAPE))
+  {
+    // Pass the keypress states to the emulation thread.
+    Chip8_ThreadSetKeys(thread, Chip8_ReadKeys(screen));
+
+    if (CheckROMKeys(screen, ROM_FileName, size))
+    {
+      Chip8_ThreadLoadROM(thread, ROM_FileName);
+    }
+
+    // Sleep until there is a new frame, or until it is time to read the keys again for the next one.
+    double Sleep = Chip8_ThreadTime();
+    Tigr *frame = Chip8_ThreadWaitFrame(thread, INPUTLEADTIME);
+    double Now = Chip8_ThreadTime();
+    Asleep += Now - Sleep;
+    Wakeups++;
+
+    // Present the newest frame, if there isn't one just keep the input moving.
+    if (frame != NULL)
+    {
+      tigrBlit(screen, frame, 0, 0, 0, 0, frame->w, frame->h);
+      tigrUpdate(screen);
+      Presented++;
+    }
+    else
+    {
+      tigrPollInput(screen);
+    }
+
+    if ((dutyCycle || pacing) && Now - ReportStart >= 1.0)
+    {
+      double Elapsed = Now - ReportStart;
+      double Busy = Chip8_ThreadBusyTime(thread);
+      Chip8_Pacing Pacing;
+      Chip8_ThreadPacing(thread, &Pacing);
+
+      if (dutyCycle)
+      {
+        printf("Duty cycle: UI %.2f%%, emulation %.2f%%, %.0f wakeups and %.0f frames presented per second\n",
+               100.0 * (Elapsed - Asleep) / Elapsed, 100.0 * (Busy - EmulationBusy) / Elapsed,
+               Wakeups / Elapsed, Presented / Elapsed);
+      }
+      if (pacing)
+      {
+        printf("Pacing: %ld frames, %.3f ms apart, jitter %.3f ms, at most %.3f ms late\n",
+               Pacing.Frames, Pacing.MeanInterval * 1000.0, Pacing.Jitter * 1000.0, Pacing.MaxLate * 1000.0);
+      }
+      fflush(stdout);
+
+      ReportStart = Now;
+      EmulationBusy = Busy;
+      Asleep = 0;
+      Wakeups = 0;
+      Presented = 0;
+    }
+  }
+
+  Chip8_ThreadStop(thread);
+  Chip8_PhosphorDestroy(phosphor);
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+
+/*
+ * Function: main
+ * Main entry point for the application.
+ *
+ * Parameters:
+ * int argc     - Number of command line parameters
+ * char *argv[] - Array of the the command line parameters
+ *
+ * Options:
+ * -core decoded|threaded|jit|compiled - Select the interpreter core.
+ * -benchmark cycles                   - Run the ROM uncapped without a window and report its speed.
+ * -drawbenchmark frames               - Time the screen renderers without a window.
+ * -phosphor decay                     - Fade pixels out over several frames, keeping decay (0 to 1) of their brightness each frame.
+ * -filter none|scale2x|scale3x       - Scale the display up with a pixel art filter.
+ * -software                           - Present without OpenGL, through MIT-SHM images (X11 only).
+ * -presentbenchmark frames            - Time presenting frames through the OpenGL and software paths.
+ * -ips rate                           - Emulate rate instructions per second, 600 by default.
+ * -timing flat|vip|schip              - Charge each instruction one cycle, or the VIP's or SuperChip's cycles at their clock.
+ * -profile name                       - Follow the quirks of default, chip8, schip10, schip11 or xochip.
+ * -dutycycle                          - Report how much of each second the UI and emulation threads spend awake.
+ * -pacing                             - Report the emulation thread's frame timing and jitter each second.
+ *
+ * Returns:
+ * int.
+ */
+int main(int argc, char *argv[])
+{
+  Tigr *screen = NULL;
+  Chip8_Machine *chip8 = NULL;
+  char ROM_FileName[1024] = {'\0'};
+  int Core = CHIP8_DEFAULT_CORE;
+  long BenchmarkCycles = 0;
+  int DrawBenchmarkFrames = 0;
+  double PhosphorDecay = 0;
+  int Filter = CHIP8_FILTER_NONE;
+  int WindowFlags = TIGR_FIXED;
+  int PresentBenchmarkFrames = 0;
+  int DutyCycle = 0;
+  int Pacing = 0;
+  int InstructionsPerSecond = CHIP8_DEFAULT_SPEED;
+  int Timing = CHIP8_TIMING_FLAT;
+  int Profile = CHIP8_PROFILE_DEFAULT;
+  int HeadlessFrames = 0;
+  char *InputFileName = NULL;
+  int Trace = 0;
+  int SeedGiven = 0;
+  uint32_t Seed = HEADLESSSEED;
+
+  // Process the command line, anything that isn't an option is the ROM to load.
+  for (int arg = 1; arg < argc; arg++)
+  {
+    if (strcmp(argv[arg], "-core") == 0 && arg + 1 < argc)
+    {
+      arg++;
+      if (strcmp(argv[arg], "threaded") == 0)
+      {
+        Core = CHIP8_CORE_THREADED;
+      }
+      else if (strcmp(argv[arg], "jit") == 0)
+      {
+        Core = CHIP8_CORE_JIT;
+      }
+      else if (strcmp(argv[arg], "compiled") == 0)
+      {
+        Core = CHIP8_CORE_COMPILED;
+      }
+      else
+      {
+        Core = CHIP8_CORE_DECODED;
+      }
+    }
+    else if (strcmp(argv[arg], "-benchmark") == 0 && arg + 1 < argc)
+    {
+      BenchmarkCycles = atol(argv[++arg]);
+    }
+    else if (strcmp(argv[arg], "-drawbenchmark") == 0 && arg + 1 < argc)
+    {
+      DrawBenchmarkFrames = atoi(argv[++arg]);
+    }
+    else if (strcmp(argv[arg], "-phosphor") == 0 && arg + 1 < argc)
+    {
+      PhosphorDecay = atof(argv[++arg]);
+    }
+    else if (strcmp(argv[arg], "-filter") == 0 && arg + 1 < argc)
+    {
+      arg++;
+      if (strcmp(argv[arg], "scale2x") == 0)
+      {
+        Filter = CHIP8_FILTER_SCALE2X;
+      }
+      else if (strcmp(argv[arg], "scale3x") == 0)
+      {
+        Filter = CHIP8_FILTER_SCALE3X;
+      }
+      else
+      {
+        Filter = CHIP8_FILTER_NONE;
+      }
+    }
+    else if (strcmp(argv[arg], "-software") == 0)
+    {
+      WindowFlags |= TIGR_SOFTWARE;
+    }
+    else if (strcmp(argv[arg], "-presentbenchmark") == 0 && arg + 1 < argc)
+    {
+      PresentBenchmarkFrames = atoi(argv[++arg]);
+    }
+    else if (strcmp(argv[arg], "-dutycycle") == 0)
+    {
+      DutyCycle = 1;
+    }
+    else if (strcmp(argv[arg], "-pacing") == 0)
+    {
+      Pacing = 1;
+    }
+    else if (strcmp(argv[arg], "-ips") == 0 && arg + 1 < argc)
+    {
+      InstructionsPerSecond = atoi(argv[++arg]);
+      if (InstructionsPerSecond <= 0)
+      {
+        InstructionsPerSecond = CHIP8_DEFAULT_SPEED;
+      }
+    }
+    else if (strcmp(argv[arg], "-timing") == 0 && arg + 1 < argc)
+    {
+      arg++;
+      if (strcmp(argv[arg], "vip") == 0)
+      {
+        Timing = CHIP8_TIMING_VIP;
+      }
+      else if (strcmp(argv[arg], "schip") == 0)
+      {
+        Timing = CHIP8_TIMING_SCHIP;
+      }
+      else
+      {
+        Timing = CHIP8_TIMING_FLAT;
+      }
+    }
+    else if (strcmp(argv[arg], "-profile") == 0 && arg + 1 < argc)
+    {
+      arg++;
+      if (strcmp(argv[arg], "chip8") == 0)
+      {
+        Profile = CHIP8_PROFILE_CHIP8;
+      }
+      else if (strcmp(argv[arg], "schip10") == 0)
+      {
+        Profile = CHIP8_PROFILE_SCHIP10;
+      }
+      else if (strcmp(argv[arg], "schip11") == 0)
+      {
+        Profile = CHIP8_PROFILE_SCHIP11;
+      }
+      else if (strcmp(argv[arg], "xochip") == 0)
+      {
+        Profile = CHIP8_PROFILE_XOCHIP;
+      }
+      else
+      {
+        Profile = CHIP8_PROFILE_DEFAULT;
+      }
+    }
+    else if (strcmp(argv[arg], "-headless") == 0 && arg + 1 < argc)
+    {
+      HeadlessFrames = atoi(argv[++arg]);
+    }
+    else if (strcmp(argv[arg], "-input") == 0 && arg + 1 < argc)
+    {
+      InputFileName = argv[++arg];
+    }
+    else if (strcmp(argv[arg], "-trace") == 0)
+    {
+      Trace = 1;
+    }
+    else if (strcmp(argv[arg], "-seed") == 0 && arg + 1 < argc)
+    {
+      Seed = (uint32_t)strtoul(argv[++arg], NULL, 0);
+      SeedGiven = 1;
+    }
+    else
+    {
+      strncpy(ROM_FileName, argv[arg], sizeof(ROM_FileName) - 1);
+    }
+  }
+
+  // Create the Chip8 machine, this also initialises the registers.
+  chip8 = Chip8_Create();
+  if (chip8 == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  chip8->Core = Core;
+  chip8->Profile = Profile;
+
+  // The VIP and SuperChip models run at their own clock, -ips only sets the speed of the flat one.
+  Chip8_SetTiming(chip8, Timing);
+  if (Timing == CHIP8_TIMING_FLAT)
+  {
+    Chip8_SetSpeed(chip8, InstructionsPerSecond);
+  }
+
+  // Headless runs replay the same random numbers unless asked otherwise, windowed ones only with -seed.
+  if (SeedGiven || HeadlessFrames > 0)
+  {
+    Chip8_SetSeed(chip8, Seed);
+  }
+
+  // Benchmarks run headless, apart from the present benchmark, on the ROM given or the splash screen.
+  if (BenchmarkCycles > 0 || DrawBenchmarkFrames > 0 || PresentBenchmarkFrames > 0 || HeadlessFrames > 0)
+  {
+    if (strlen(ROM_FileName) > 0 && Chip8_LoadROM(chip8, ROM_FileName) != EXIT_SUCCESS)
+    {
+      printf("Unable to load %s\n", ROM_FileName);
+      Chip8_Destroy(chip8);
+      return EXIT_FAILURE;
+    }
+    int Result = EXIT_SUCCESS;
+    if (HeadlessFrames > 0)
+    {
+      Result = RunHeadless(chip8, HeadlessFrames, InputFileName, Trace);
+    }
+    if (BenchmarkCycles > 0)
+    {
+      RunBenchmark(chip8, BenchmarkCycles);
+    }
+    if (DrawBenchmarkFrames > 0)
+    {
+      Result = RunDrawBenchmark(chip8, DrawBenchmarkFrames);
+    }
+    if (PresentBenchmarkFrames > 0)
+    {
+      RunPresentBenchmark(chip8, PresentBenchmarkFrames);
+    }
+    Chip8_Destroy(chip8);
+    return Result;
+  }
+
+  // Initialise the applications window, its bitmap is the Chip8's native resolution times the
+  // filter's scale and tigr scales it up to the largest integer scale that fits the resizable window.
+  chip8->Filter = Filter;
+  screen = tigrWindow(CLIENTWIDTH * Chip8_FilterScale(Filter), CLIENTHEIGHT * Chip8_FilterScale(Filter), "Super Chip", WindowFlags);
+
+  // Clear the client window contents before we start.
+  tigrClear(screen, BACKGROUND);
+
+  // No ROM on the command line, so browse for a CHIP8 ROM file instead.
+  if (strlen(ROM_FileName) == 0)
+  {
+    OpenFileDialog(ROM_FileName, sizeof(ROM_FileName));
+  }
+
+  // Load the selected ROM file.
+  if (strlen(ROM_FileName) > 0)
+  {
+    Chip8_LoadROM(chip8, ROM_FileName);
+  }
+
+#ifdef NDEBUG
+  // The debugger draws straight to the window, without the phosphor stage.
+  (void)PhosphorDecay;
+  (void)DutyCycle;
+  (void)Pacing;
+  RunDebugger(chip8, screen, ROM_FileName, sizeof(ROM_FileName));
+#else
+  RunThreaded(chip8, screen, ROM_FileName, sizeof(ROM_FileName), PhosphorDecay,
+              chip8->CyclesPerSecond, DutyCycle, Pacing);
+#endif
+
+  // Close the window and shut down Tigr.
+  tigrFree(screen);
+
+  // Free the Chip8 machine.
+  Chip8_Destroy(chip8);
+
+  // Return to the OS.
+  return EXIT_SUCCESS;
+}
@@ -40,6 +40,7 @@ void tigrPosition(Tigr* bmp, int scale, int windowW, int windowH, int out[4]);
 #if !defined(TIGR_HEADLESS) && __linux__ && !__ANDROID__
 #include <X11/X.h>
 #include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
 #endif
 
 #ifdef __APPLE__
@@ -111,6 +112,11 @@ typedef struct {
     Window win;
     GLXContext glc;
     XIC ic;
+    int software;           // Presenting through XImages instead of OpenGL (TIGR_SOFTWARE).
+    GC gc;
+    XImage* image;          // Window sized, NULL until the first present.
+    XShmSegmentInfo shm;    // shm.shmaddr is NULL if the image is not in shared memory.
+    int imagePos[4];        // Where the bitmap was last scaled to in the image.
 #endif  // __ANDROID__
 #endif  // __linux__
 #endif  // TIGR_GAPI_GL
@@ -354,16 +360,173 @@ void tigrPosition(Tigr* bmp, int scale, int windowW, int windowH, int out[4]) {
     out[3] = out[1] + bmp->h * scale;
 }
 
+// SIMD kernels need GCC or Clang on an x86 host, everything else uses the scalar kernel.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TIGR_SIMD
+#include <immintrin.h>
+#include <stdint.h>
+#endif
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+// Spans bigger than this are written around the cache. They would only evict what is drawn next.
+#define TIGR_STREAM_BYTES (4 << 20)
+
+typedef void (*TigrFillSpan)(TPixel* td, int count, TPixel color, int stream);
+
+static void tigrFillSpanScalar(TPixel* td, int count, TPixel color, int stream) {
+    (void)stream;
+    for (int i = 0; i < count; i++)
+        td[i] = color;
+}
+
+#ifdef TIGR_SIMD
+__attribute__((target("sse2"))) static void tigrFillSpanSSE2(TPixel* td, int count, TPixel color, int stream) {
+    unsigned int c;
+    memcpy(&c, &color, sizeof(c));
+    __m128i v = _mm_set1_epi32((int)c);
+    int i = 0;
+
+    // Pixels up to a 16 byte boundary, so the wide stores are aligned.
+    while (i < count && ((uintptr_t)&td[i] & 15))
+        td[i++] = color;
+
+    if (stream) {
+        for (; i + 4 <= count; i += 4)
+            _mm_stream_si128((__m128i*)&td[i], v);
+        _mm_sfence();
+    } else {
+        for (; i + 8 <= count; i += 8) {
+            _mm_store_si128((__m128i*)&td[i], v);
+            _mm_store_si128((__m128i*)&td[i + 4], v);
+        }
+        if (i + 4 <= count) {
+            _mm_store_si128((__m128i*)&td[i], v);
+            i += 4;
+        }
+    }
+
+    for (; i < count; i++)
+        td[i] = color;
+}
+
+__attribute__((target("avx2"))) static void tigrFillSpanAVX2(TPixel* td, int count, TPixel color, int stream) {
+    unsigned int c;
+    memcpy(&c, &color, sizeof(c));
+    __m256i v = _mm256_set1_epi32((int)c);
+    int i = 0;
+
+    // Short spans, like single CHIP-8 pixels, aren't worth lining up.
+    if (count < 16) {
+        for (; i + 8 <= count; i += 8)
+            _mm256_storeu_si256((__m256i*)&td[i], v);
+        if (i + 4 <= count) {
+            _mm_storeu_si128((__m128i*)&td[i], _mm256_castsi256_si128(v));
+            i += 4;
+        }
+        for (; i < count; i++)
+            td[i] = color;
+        return;
+    }
+
+    // One unaligned store covers the pixels up to a 32 byte boundary.
+    _mm256_storeu_si256((__m256i*)td, v);
+    i = (int)((32 - ((uintptr_t)td & 31)) & 31) / (int)sizeof(TPixel);
+
+    if (stream && !((uintptr_t)&td[i] & 31)) {
+        for (; i + 8 <= count; i += 8)
+            _mm256_stream_si256((__m256i*)&td[i], v);
+        _mm_sfence();
+    } else {
+        for (; i + 16 <= count; i += 16) {
+            _mm256_storeu_si256((__m256i*)&td[i], v);
+            _mm256_storeu_si256((__m256i*)&td[i + 8], v);
+        }
+        if (i + 8 <= count) {
+            _mm256_storeu_si256((__m256i*)&td[i], v);
+            i += 8;
+        }
+    }
+
+    // One unaligned store, overlapping what's already done, covers the rest.
+    if (i < count)
+        _mm256_storeu_si256((__m256i*)&td[count - 8], v);
+}
+#endif
+
+// The widest kernel is picked under a one-time init the first time anything is filled, so threads
+// drawing at once don't race to pick it. tigrSetKernel replaces it afterwards.
+static TigrFillSpan tigrFillSpan;
+#ifdef _WIN32
+static INIT_ONCE tigrFillSpanOnce = INIT_ONCE_STATIC_INIT;
+#else
+static pthread_once_t tigrFillSpanOnce = PTHREAD_ONCE_INIT;
+#endif
+
+static int tigrPickKernel(int kernel) {
+    int best = TIGR_KERNEL_SCALAR;
+#ifdef TIGR_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        best = TIGR_KERNEL_AVX2;
+    else if (__builtin_cpu_supports("sse2"))
+        best = TIGR_KERNEL_SSE2;
+#endif
+    if (kernel < 0 || kernel > best)
+        kernel = best;
+
+    switch (kernel) {
+#ifdef TIGR_SIMD
+        case TIGR_KERNEL_AVX2:
+            tigrFillSpan = tigrFillSpanAVX2;
+            break;
+        case TIGR_KERNEL_SSE2:
+            tigrFillSpan = tigrFillSpanSSE2;
+            break;
+#endif
+        default:
+            tigrFillSpan = tigrFillSpanScalar;
+            break;
+    }
+    return kernel;
+}
+
+#ifdef _WIN32
+static BOOL CALLBACK tigrPickDefaultKernel(PINIT_ONCE once, PVOID parameter, PVOID* context) {
+    tigrPickKernel(TIGR_KERNEL_AUTO);
+    return TRUE;
+}
+#else
+static void tigrPickDefaultKernel(void) {
+    tigrPickKernel(TIGR_KERNEL_AUTO);
+}
+#endif
+
+static TigrFillSpan tigrGetFillSpan() {
+#ifdef _WIN32
+    InitOnceExecuteOnce(&tigrFillSpanOnce, tigrPickDefaultKernel, NULL, NULL);
+#else
+    pthread_once(&tigrFillSpanOnce, tigrPickDefaultKernel);
+#endif
+    return tigrFillSpan;
+}
+
+int tigrSetKernel(int kernel) {
+    // Pick the default first, so it can't later replace the kernel chosen here.
+    tigrGetFillSpan();
+    return tigrPickKernel(kernel);
+}
+
 void tigrClear(Tigr* bmp, TPixel color) {
     int count = bmp->w * bmp->h;
-    int n;
-    for (n = 0; n < count; n++)
-        bmp->pix[n] = color;
+    tigrGetFillSpan()(bmp->pix, count, color, (size_t)count * sizeof(TPixel) >= TIGR_STREAM_BYTES);
 }
 
 void tigrFill(Tigr* bmp, int x, int y, int w, int h, TPixel color) {
     TPixel* td;
-    int dt, i;
+    int dt;
 
     if (x < 0) {
         w += x;
@@ -382,11 +545,18 @@ void tigrFill(Tigr* bmp, int x, int y, int w, int h, TPixel color) {
     if (w <= 0 || h <= 0)
         return;
 
+    TigrFillSpan fill = tigrGetFillSpan();
     td = &bmp->pix[y * bmp->w + x];
     dt = bmp->w;
+
+    // Whole rows are one span.
+    if (w == dt) {
+        fill(td, w * h, color, (size_t)w * h * sizeof(TPixel) >= TIGR_STREAM_BYTES);
+        return;
+    }
+
     do {
-        for (i = 0; i < w; i++)
-            td[i] = color;
+        fill(td, w, color, 0);
         td += dt;
     } while (--h);
 }
@@ -599,6 +769,13 @@ void tigrBlit(Tigr* dst, Tigr* src, int dx, int dy, int sx, int sy, int w, int h
     TPixel* td = &dst->pix[dy * dst->w + dx];
     int st = src->w;
     int dt = dst->w;
+
+    // Whole rows of the same width are one copy.
+    if (w == st && w == dt) {
+        memcpy(td, ts, (size_t)w * h * sizeof(TPixel));
+        return;
+    }
+
     do {
         memcpy(td, ts, w * sizeof(TPixel));
         ts += st;
@@ -2136,6 +2313,28 @@ void tigrUpdate(Tigr* bmp) {
     }
 }
 
+void tigrPollInput(Tigr* bmp) {
+    MSG msg;
+    TigrInternal* win = tigrInternal(bmp);
+
+    if (!win->shown) {
+        win->shown = 1;
+        UpdateWindow((HWND)bmp->handle);
+        ShowWindow((HWND)bmp->handle, SW_SHOW);
+    }
+
+    memcpy(win->prev, win->keys, 256);
+
+    // Run the message pump, WM_PAINT still presents if the window needs repainting.
+    while (PeekMessage(&msg, (HWND)bmp->handle, 0, 0, PM_REMOVE)) {
+        if (msg.message == WM_QUIT)
+            break;
+
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
+}
+
 typedef BOOL(APIENTRY* PFNWGLSWAPINTERVALFARPROC_)(int);
 static PFNWGLSWAPINTERVALFARPROC_ wglSwapIntervalEXT_ = 0;
 
@@ -3735,6 +3934,10 @@ void tigrUpdate(Tigr* bmp) {
     tigrGAPIEnd(bmp);
 }
 
+void tigrPollInput(Tigr* bmp) {
+    tigrUpdate(bmp);
+}
+
 int tigrGAPIBegin(Tigr* bmp) {
     TigrInternal* win = tigrInternal(bmp);
     objc_msgSend_void((id)win->gl.glContext, sel("makeCurrentContext"));
@@ -4273,6 +4476,10 @@ void tigrUpdate(Tigr* bmp) {
     waitForFrame();
 }
 
+void tigrPollInput(Tigr* bmp) {
+    tigrUpdate(bmp);
+}
+
 int tigrClosed(Tigr* bmp) {
     return 0;
 }
@@ -4435,11 +4642,16 @@ void tigr_android_destroy();
 #include <X11/Xlocale.h>
 #include <X11/XKBlib.h>
 #include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
 #include <GL/glx.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 
 static Display* dpy;
 static Window root;
 static XVisualInfo* vi;
+static XVisualInfo softwareVisual;
 static Atom wmDeleteMessage;
 static XIM inputMethod;
 static GLXFBConfig fbConfig;
@@ -4456,6 +4668,20 @@ static void initX11Stuff() {
 
         root = DefaultRootWindow(dpy);
 
+        inputMethod = XOpenIM(dpy, NULL, NULL, NULL);
+        if (inputMethod == NULL) {
+            tigrError(0, "Failed to create input method");
+        }
+
+        wmDeleteMessage = XInternAtom(dpy, "WM_DELETE_WINDOW", False);
+
+        done = 1;
+    }
+}
+
+static void initGLXStuff() {
+    static int done = 0;
+    if (!done) {
         static int attribList[] = { GLX_RENDER_TYPE,
                                     GLX_RGBA_BIT,
                                     GLX_DRAWABLE_TYPE,
@@ -4490,17 +4716,21 @@ static void initX11Stuff() {
             tigrError(0, "Failed to get glXCreateContextAttribsARB");
         }
 
-        inputMethod = XOpenIM(dpy, NULL, NULL, NULL);
-        if (inputMethod == NULL) {
-            tigrError(0, "Failed to create input method");
-        }
-
-        wmDeleteMessage = XInternAtom(dpy, "WM_DELETE_WINDOW", False);
-
         done = 1;
     }
 }
 
+// The software path needs a 24 bit TrueColor visual with 8 bits per channel.
+static int initSoftwareStuff() {
+    static int supported = -1;
+    if (supported < 0) {
+        supported = XMatchVisualInfo(dpy, DefaultScreen(dpy), 24, TrueColor, &softwareVisual) &&
+                    softwareVisual.red_mask == 0xff0000 && softwareVisual.green_mask == 0xff00 &&
+                    softwareVisual.blue_mask == 0xff;
+    }
+    return supported;
+}
+
 static int hasGLXExtension(Display* display, const char* wanted) {
     const char* extensions = glXQueryExtensionsString(display, DefaultScreen(display));
     char* dup = strdup(extensions);
@@ -4553,6 +4783,165 @@ static void tigrHideCursor(TigrInternal* win) {
     XFreePixmap(win->dpy, bitmapNoData);
 }
 
+static int shmAttachFailed;
+
+static int tigrShmErrorHandler(Display* display, XErrorEvent* event) {
+    (void)display;
+    (void)event;
+    shmAttachFailed = 1;
+    return 0;
+}
+
+static void tigrSoftwareDestroyImage(TigrInternal* win) {
+    if (win->image) {
+        if (win->shm.shmaddr) {
+            XShmDetach(win->dpy, &win->shm);
+            XSync(win->dpy, False);
+            shmdt(win->shm.shmaddr);
+            win->shm.shmaddr = NULL;
+            win->image->data = NULL;
+        }
+        XDestroyImage(win->image);
+        win->image = NULL;
+    }
+}
+
+// Makes a w x h image to present from, in shared memory if the server supports
+// MIT-SHM and can attach to it, otherwise in client memory sent with XPutImage.
+static int tigrSoftwareCreateImage(TigrInternal* win, int w, int h) {
+    memset(&win->shm, 0, sizeof(win->shm));
+    memset(win->imagePos, 0, sizeof(win->imagePos));
+
+    if (XShmQueryExtension(win->dpy)) {
+        win->image = XShmCreateImage(win->dpy, softwareVisual.visual, softwareVisual.depth, ZPixmap, NULL,
+                                     &win->shm, w, h);
+        if (win->image) {
+            win->shm.shmid = shmget(IPC_PRIVATE, win->image->bytes_per_line * h, IPC_CREAT | 0600);
+            win->shm.shmaddr = win->shm.shmid < 0 ? NULL : (char*)shmat(win->shm.shmid, NULL, 0);
+            if (win->shm.shmaddr == (char*)-1) {
+                win->shm.shmaddr = NULL;
+            }
+            if (win->shm.shmaddr) {
+                // Attaching fails on remote displays, which only shows up as an X error.
+                XErrorHandler oldHandler = XSetErrorHandler(tigrShmErrorHandler);
+                shmAttachFailed = 0;
+                win->shm.readOnly = False;
+                win->image->data = win->shm.shmaddr;
+                XShmAttach(win->dpy, &win->shm);
+                XSync(win->dpy, False);
+                XSetErrorHandler(oldHandler);
+                if (shmAttachFailed) {
+                    shmdt(win->shm.shmaddr);
+                    win->shm.shmaddr = NULL;
+                }
+            }
+            if (win->shm.shmid >= 0) {
+                // The segment is freed once both sides have detached.
+                shmctl(win->shm.shmid, IPC_RMID, NULL);
+            }
+            if (win->shm.shmaddr == NULL) {
+                win->image->data = NULL;
+                XDestroyImage(win->image);
+                win->image = NULL;
+            }
+        }
+    }
+
+    if (win->image == NULL) {
+        win->image = XCreateImage(win->dpy, softwareVisual.visual, softwareVisual.depth, ZPixmap, 0, NULL, w, h, 32, 0);
+        if (win->image) {
+            win->image->data = (char*)calloc(win->image->bytes_per_line, h);
+            if (win->image->data == NULL) {
+                XDestroyImage(win->image);
+                win->image = NULL;
+            }
+        }
+    }
+
+    if (win->image && win->image->bits_per_pixel != 32) {
+        tigrSoftwareDestroyImage(win);
+    }
+    return win->image != NULL;
+}
+
+// Scales the bitmap into the window sized image on the CPU and puts it on the window.
+static void tigrSoftwarePresent(Tigr* bmp, int w, int h) {
+    TigrInternal* win = tigrInternal(bmp);
+    int scale = win->scale;
+    int x1 = win->pos[0], y1 = win->pos[1];
+    const unsigned int one = 1;
+
+    if (win->image == NULL || win->image->width != w || win->image->height != h) {
+        tigrSoftwareDestroyImage(win);
+        if (!tigrSoftwareCreateImage(win, w, h)) {
+            return;
+        }
+    }
+
+    // Pixels are 0x00RRGGBB, swapped if the server's byte order differs from ours.
+    int swap = win->image->byte_order != (*(const unsigned char*)&one ? LSBFirst : MSBFirst);
+
+    // Clear the border when the bitmap moves.
+    if (memcmp(win->imagePos, win->pos, sizeof(win->imagePos)) != 0) {
+        memset(win->image->data, 0, win->image->bytes_per_line * h);
+        memcpy(win->imagePos, win->pos, sizeof(win->imagePos));
+    }
+
+    for (int y = 0; y < bmp->h; y++) {
+        int top = y1 + y * scale, bottom = top + scale;
+        top = top < 0 ? 0 : top;
+        bottom = bottom > h ? h : bottom;
+        if (top >= bottom) {
+            continue;
+        }
+
+        // Scale the row into its first line, then copy that down.
+        unsigned int* line = (unsigned int*)(win->image->data + top * win->image->bytes_per_line);
+        const TPixel* src = &bmp->pix[y * bmp->w];
+        for (int x = 0; x < bmp->w; x++) {
+            unsigned int c = (src[x].r << 16) | (src[x].g << 8) | src[x].b;
+            if (swap) {
+                c = (c << 24) | ((c & 0xff00) << 8) | ((c >> 8) & 0xff00) | (c >> 24);
+            }
+            int left = x1 + x * scale, right = left + scale;
+            left = left < 0 ? 0 : left;
+            right = right > w ? w : right;
+            for (int i = left; i < right; i++) {
+                line[i] = c;
+            }
+        }
+        for (int i = top + 1; i < bottom; i++) {
+            memcpy(win->image->data + i * win->image->bytes_per_line, line, w * sizeof(unsigned int));
+        }
+    }
+
+    if (win->shm.shmaddr) {
+        XShmPutImage(win->dpy, win->win, win->gc, win->image, 0, 0, 0, 0, w, h, False);
+    } else {
+        XPutImage(win->dpy, win->win, win->gc, win->image, 0, 0, 0, 0, w, h);
+    }
+
+    // Wait for the server to finish reading the image before it is drawn into again.
+    XSync(win->dpy, False);
+}
+
+// Kept out of line so GCC doesn't follow tigrInternal into plain bitmaps inlined into tigrFree,
+// which it then warns about reading past. Does nothing once the window is gone.
+__attribute__((noinline)) static void tigrDestroyX11Window(TigrInternal* win) {
+    if (!win->win) {
+        return;
+    }
+    if (win->software) {
+        tigrSoftwareDestroyImage(win);
+        XFreeGC(win->dpy, win->gc);
+    } else {
+        glXMakeCurrent(win->dpy, None, NULL);
+        glXDestroyContext(win->dpy, win->glc);
+    }
+    XDestroyWindow(win->dpy, win->win);
+    win->win = 0;
+}
+
 typedef struct {
     unsigned long flags;
     unsigned long functions;
@@ -4572,6 +4961,16 @@ Tigr* tigrWindow(int w, int h, const char* title, int flags) {
 
     initX11Stuff();
 
+    // Fall back to OpenGL if the display can't take our images.
+    int software = (flags & TIGR_SOFTWARE) && initSoftwareStuff();
+    Visual* visual = software ? softwareVisual.visual : NULL;
+    int depth = software ? softwareVisual.depth : 0;
+    if (!software) {
+        initGLXStuff();
+        visual = vi->visual;
+        depth = vi->depth;
+    }
+
     if (flags & TIGR_AUTO) {
         // Always use a 1:1 pixel size, unless downscaled by tigrEnforceScale below.
         scale = 1;
@@ -4585,12 +4984,12 @@ Tigr* tigrWindow(int w, int h, const char* title, int flags) {
 
     scale = tigrEnforceScale(scale, flags);
 
-    cmap = XCreateColormap(dpy, root, vi->visual, AllocNone);
+    cmap = XCreateColormap(dpy, root, visual, AllocNone);
     swa.colormap = cmap;
     swa.event_mask = StructureNotifyMask;
 
     // Create window of wanted size
-    xwin = XCreateWindow(dpy, root, 0, 0, w * scale, h * scale, 0, vi->depth, InputOutput, vi->visual,
+    xwin = XCreateWindow(dpy, root, 0, 0, w * scale, h * scale, 0, depth, InputOutput, visual,
                          CWColormap | CWEventMask, &swa);
     XMapWindow(dpy, xwin);
 
@@ -4634,12 +5033,15 @@ Tigr* tigrWindow(int w, int h, const char* title, int flags) {
 
     XSetWMProtocols(dpy, xwin, &wmDeleteMessage, 1);
 
-    glc = glXCreateContext(dpy, vi, NULL, GL_TRUE);
-    int contextAttributes[] = { GLX_CONTEXT_MAJOR_VERSION_ARB, 3, GLX_CONTEXT_MINOR_VERSION_ARB, 3, None };
-    glc = glXCreateContextAttribsARB(dpy, fbConfig, NULL, GL_TRUE, contextAttributes);
-    glXMakeCurrent(dpy, xwin, glc);
+    glc = NULL;
+    if (!software) {
+        glc = glXCreateContext(dpy, vi, NULL, GL_TRUE);
+        int contextAttributes[] = { GLX_CONTEXT_MAJOR_VERSION_ARB, 3, GLX_CONTEXT_MINOR_VERSION_ARB, 3, None };
+        glc = glXCreateContextAttribsARB(dpy, fbConfig, NULL, GL_TRUE, contextAttributes);
+        glXMakeCurrent(dpy, xwin, glc);
 
-    setupVSync(dpy, xwin);
+        setupVSync(dpy, xwin);
+    }
 
     bmp = tigrBitmap2(w, h, sizeof(TigrInternal));
     bmp->handle = (void*)xwin;
@@ -4649,6 +5051,9 @@ Tigr* tigrWindow(int w, int h, const char* title, int flags) {
     win->dpy = dpy;
     win->glc = glc;
     win->ic = ic;
+    win->software = software;
+    win->gc = software ? XCreateGC(dpy, xwin, 0, NULL) : 0;
+    win->image = NULL;
 
     win->shown = 0;
     win->closed = 0;
@@ -4672,8 +5077,10 @@ Tigr* tigrWindow(int w, int h, const char* title, int flags) {
     }
 
     tigrPosition(bmp, win->scale, bmp->w, bmp->h, win->pos);
-    tigrGAPICreate(bmp);
-    tigrGAPIBegin(bmp);
+    if (!software) {
+        tigrGAPICreate(bmp);
+        tigrGAPIBegin(bmp);
+    }
 
     return bmp;
 }
@@ -4685,6 +5092,9 @@ int tigrClosed(Tigr* bmp) {
 
 int tigrGAPIBegin(Tigr* bmp) {
     TigrInternal* win = tigrInternal(bmp);
+    if (win->software) {
+        return -1;
+    }
     return glXMakeCurrent(win->dpy, win->win, win->glc) ? 0 : -1;
 }
 
@@ -4958,10 +5368,7 @@ static void tigrProcessInput(TigrInternal* win, int winWidth, int winHeight) {
     XEvent event;
     while (XCheckTypedWindowEvent(win->dpy, win->win, ClientMessage, &event)) {
         if (event.xclient.data.l[0] == wmDeleteMessage) {
-            glXMakeCurrent(win->dpy, None, NULL);
-            glXDestroyContext(win->dpy, win->glc);
-            XDestroyWindow(win->dpy, win->win);
-            win->win = 0;
+            tigrDestroyX11Window(win);
         }
     }
     XFlush(win->dpy);
@@ -4982,22 +5389,43 @@ void tigrUpdate(Tigr* bmp) {
         win->scale = tigrEnforceScale(tigrCalcScale(bmp->w, bmp->h, gwa.width, gwa.height), win->flags);
 
     tigrPosition(bmp, win->scale, gwa.width, gwa.height, win->pos);
-    glXMakeCurrent(win->dpy, win->win, win->glc);
-    tigrGAPIPresent(bmp, gwa.width, gwa.height);
-    glXSwapBuffers(win->dpy, win->win);
+    if (win->software) {
+        tigrSoftwarePresent(bmp, gwa.width, gwa.height);
+    } else {
+        glXMakeCurrent(win->dpy, win->win, win->glc);
+        tigrGAPIPresent(bmp, gwa.width, gwa.height);
+        glXSwapBuffers(win->dpy, win->win);
+    }
 
     tigrProcessInput(win, gwa.width, gwa.height);
 }
 
+void tigrPollInput(Tigr* bmp) {
+    XWindowAttributes gwa;
+    int scale, pos[4];
+
+    TigrInternal* win = tigrInternal(bmp);
+
+    XGetWindowAttributes(win->dpy, win->win, &gwa);
+
+    // If the window was resized, present again at the new scale and position.
+    if (win->flags & TIGR_AUTO)
+        scale = win->scale;
+    else
+        scale = tigrEnforceScale(tigrCalcScale(bmp->w, bmp->h, gwa.width, gwa.height), win->flags);
+    tigrPosition(bmp, scale, gwa.width, gwa.height, pos);
+    if (scale != win->scale || memcmp(pos, win->pos, sizeof(pos)) != 0) {
+        tigrUpdate(bmp);
+        return;
+    }
+
+    memcpy(win->prev, win->keys, 256);
+    tigrProcessInput(win, gwa.width, gwa.height);
+}
+
 void tigrFree(Tigr* bmp) {
     if (bmp->handle) {
-        TigrInternal* win = tigrInternal(bmp);
-        if (win->win) {
-            glXMakeCurrent(win->dpy, None, NULL);
-            glXDestroyContext(win->dpy, win->glc);
-            XDestroyWindow(win->dpy, win->win);
-            win->win = 0;
-        }
+        tigrDestroyX11Window(tigrInternal(bmp));
     }
     free(bmp->pix);
     free(bmp);
@@ -5741,6 +6169,10 @@ void tigrUpdate(Tigr* bmp) {
     tigrGAPIEnd(bmp);
 }
 
+void tigrPollInput(Tigr* bmp) {
+    tigrUpdate(bmp);
+}
+
 void tigrFree(Tigr* bmp) {
     if (bmp->handle) {
         TigrInternal* win = tigrInternal(bmp);
@@ -6410,7 +6842,9 @@ int tigrBeginOpenGL(Tigr* bmp) {
 
 void tigrSetPostShader(Tigr* bmp, const char* code, int size) {
 #ifdef TIGR_GAPI_GL
-    tigrGAPIBegin(bmp);
+    if (tigrGAPIBegin(bmp) != 0) {
+        return;
+    }
     TigrInternal* win = tigrInternal(bmp);
     GLStuff* gl = &win->gl;
     tigrCreateShaderProgram(gl, code, size);
@@ -45,6 +45,7 @@ typedef struct {
 #define TIGR_RETINA     16  // enable retina support on OS X
 #define TIGR_NOCURSOR   32  // hide cursor
 #define TIGR_FULLSCREEN 64  // start in full-screen mode
+#define TIGR_SOFTWARE   128 // present without OpenGL, through MIT-SHM images (X11 only)
 
 // A Tigr bitmap.
 typedef struct Tigr {
@@ -86,6 +87,10 @@ int tigrClosed(Tigr *bmp);
 // Displays a window's contents on-screen and updates input.
 void tigrUpdate(Tigr *bmp);
 
+// Updates input without displaying the window's contents.
+// Use instead of tigrUpdate when nothing has been drawn since the last update.
+void tigrPollInput(Tigr *bmp);
+
 // Called before doing direct OpenGL calls and before tigrUpdate.
 // Returns non-zero if OpenGL is available.
 int tigrBeginOpenGL(Tigr *bmp);
@@ -123,6 +128,17 @@ void tigrClear(Tigr *bmp, TPixel color);
 // No blending, no clipping.
 void tigrFill(Tigr *bmp, int x, int y, int w, int h, TPixel color);
 
+// Kernels used by tigrClear and tigrFill.
+#define TIGR_KERNEL_AUTO    -1  // widest kernel the CPU supports
+#define TIGR_KERNEL_SCALAR  0
+#define TIGR_KERNEL_SSE2    1
+#define TIGR_KERNEL_AVX2    2
+
+// Selects the kernel tigrClear and tigrFill use, falling back to
+// TIGR_KERNEL_AUTO if the CPU doesn't support it.
+// Returns the kernel now in use.
+int tigrSetKernel(int kernel);
+
 // Draws a line.
 // Start pixel is drawn, end pixel is not.
 // Clips and blends.